@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <git2.h>
+#include <spdlog/spdlog.h>
+
+#include "changelog.h"
+#include "synthetic_repo.h"
+#include "utils.h"
+
+// Reaches the Changelog stages the benchmarks time on their own.
+struct ChangelogBenchAccess {
+    static std::vector<SectionData> GetGitLogs(Changelog& changelog,
+                                               const std::vector<std::string>& follow) {
+        return changelog.GetGitLogs(follow);
+    }
+    static bool CommitTouchesPath(const Changelog& changelog, git_tree* parent_tree,
+                                  git_tree* commit_tree, const std::string& path) {
+        return changelog.CommitTouchesPath(changelog.repo_, parent_tree, commit_tree,
+                                           path);
+    }
+    static std::vector<ParsedSection> ParseChangelogStructured(
+        std::string_view content) {
+        return Changelog::ParseChangelogStructured(Changelog::ChangelogBody(content));
+    }
+    static std::optional<CommitType> CategorizeCommit(std::string_view summary) {
+        return Changelog::CategorizeCommit(summary);
+    }
+    static SemanticVersion DetectInitialVersion(const Changelog& changelog) {
+        return changelog.DetectInitialVersion();
+    }
+    static git_repository* Repository(const Changelog& changelog) {
+        return changelog.repo_;
+    }
+};
+
+namespace {
+
+using Access = ChangelogBenchAccess;
+
+constexpr char kBenchUrl[] = "https://github.com/bench/synthetic";
+
+struct BenchOptions {
+    std::string root =
+        (std::filesystem::temp_directory_path() / "changelog_bench").string();
+    std::vector<std::size_t> commits = {10000, 100000};
+    std::vector<std::size_t> changelog_entries = {1000, 10000, 60000};
+    std::size_t fanout = 16;
+    std::size_t tags = 1000;
+    std::size_t follow = 4;
+    int jobs = 1;
+    std::size_t pipeline_depth = 0;
+    std::size_t pipeline_batch = 256;
+    bool pack_order = false;
+};
+
+struct TreeDeleter {
+    void operator()(git_tree* tree) const { git_tree_free(tree); }
+};
+using UniqueTree = std::unique_ptr<git_tree, TreeDeleter>;
+
+struct CommitDeleter {
+    void operator()(git_commit* commit) const { git_commit_free(commit); }
+};
+using UniqueCommit = std::unique_ptr<git_commit, CommitDeleter>;
+
+struct RevwalkDeleter {
+    void operator()(git_revwalk* walker) const { git_revwalk_free(walker); }
+};
+using UniqueRevwalk = std::unique_ptr<git_revwalk, RevwalkDeleter>;
+
+void CheckGit2(int error, const char* what) {
+    if (error < 0) {
+        const git_error* e = git_error_last();
+        throw std::runtime_error(std::string(what) + ": " +
+                                 (e ? e->message : "unknown error"));
+    }
+}
+
+Changelog::Config MakeConfig(const BenchOptions& options, const std::string& repo,
+                             std::size_t follow) {
+    Changelog::Config config;
+    config.repo = repo;
+    config.url = kBenchUrl;
+    config.output = repo + "/CHANGELOG.bench.md";
+    config.jobs = options.jobs;
+    config.pipeline_depth = options.pipeline_depth;
+    config.pipeline_batch = options.pipeline_batch;
+    config.pack_order = options.pack_order;
+    for (std::size_t i = 0; i < follow; ++i) {
+        config.follow.push_back(SyntheticDirName(i));
+    }
+    return config;
+}
+
+SyntheticRepoSpec MakeSpec(const BenchOptions& options, std::size_t commits) {
+    SyntheticRepoSpec spec;
+    spec.commits = commits;
+    spec.fanout = options.fanout;
+    spec.tags = options.tags;
+    return spec;
+}
+
+std::size_t CountEntries(const std::vector<SectionData>& sections) {
+    std::size_t count = 0;
+    for (const auto& section : sections) count += section.entries.size();
+    return count;
+}
+
+void BM_GetGitLogs(benchmark::State& state, const BenchOptions& options,
+                   std::size_t commits, std::size_t follow) {
+    std::string repo = EnsureSyntheticRepo(options.root, MakeSpec(options, commits));
+    Changelog::Config config = MakeConfig(options, repo, follow);
+    for (auto _ : state) {
+        // A fresh instance per run so the string arena doesn't keep growing.
+        state.PauseTiming();
+        auto changelog = std::make_unique<Changelog>(config);
+        state.ResumeTiming();
+
+        auto sections = Access::GetGitLogs(*changelog, config.follow);
+        state.counters["entries"] = static_cast<double>(CountEntries(sections));
+
+        state.PauseTiming();
+        sections.clear();
+        changelog.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * commits);
+}
+
+// The same walk as BM_GetGitLogs through the public streaming API, which
+// keeps nothing.
+void BM_StreamEntries(benchmark::State& state, const BenchOptions& options,
+                      std::size_t commits, std::size_t follow) {
+    std::string repo = EnsureSyntheticRepo(options.root, MakeSpec(options, commits));
+    Changelog::Config config = MakeConfig(options, repo, follow);
+    Changelog changelog(config);
+    for (auto _ : state) {
+        std::size_t entries = 0;
+        changelog.StreamEntries(config.follow,
+                                [&](const Changelog::StreamedEntry&) { ++entries; });
+        state.counters["entries"] = static_cast<double>(entries);
+    }
+    state.SetItemsProcessed(state.iterations() * commits);
+}
+
+void BM_CommitTouchesPath(benchmark::State& state, const BenchOptions& options,
+                          std::size_t commits, const std::string& path) {
+    constexpr std::size_t kMaxPairs = 5000;
+    std::string repo = EnsureSyntheticRepo(options.root, MakeSpec(options, commits));
+    Changelog changelog(MakeConfig(options, repo, 0));
+    git_repository* raw_repo = Access::Repository(changelog);
+
+    // Load the trees up front so only the comparison itself is timed.
+    std::vector<std::pair<UniqueTree, UniqueTree>> pairs;
+    git_revwalk* walker_raw = nullptr;
+    CheckGit2(git_revwalk_new(&walker_raw, raw_repo), "Failed to create revwalk");
+    UniqueRevwalk walker(walker_raw);
+    CheckGit2(git_revwalk_push_head(walker.get()), "Failed to push HEAD");
+    git_oid oid;
+    while (pairs.size() < kMaxPairs && git_revwalk_next(&oid, walker.get()) == 0) {
+        git_commit* commit_raw = nullptr;
+        CheckGit2(git_commit_lookup(&commit_raw, raw_repo, &oid),
+                  "Failed to look up commit");
+        UniqueCommit commit(commit_raw);
+        if (git_commit_parentcount(commit.get()) == 0) break;
+        git_commit* parent_raw = nullptr;
+        CheckGit2(git_commit_parent(&parent_raw, commit.get(), 0),
+                  "Failed to look up parent");
+        UniqueCommit parent(parent_raw);
+        git_tree* tree = nullptr;
+        git_tree* parent_tree = nullptr;
+        CheckGit2(git_commit_tree(&tree, commit.get()), "Failed to load tree");
+        CheckGit2(git_commit_tree(&parent_tree, parent.get()), "Failed to load tree");
+        pairs.emplace_back(UniqueTree(parent_tree), UniqueTree(tree));
+    }
+
+    std::size_t touched = 0;
+    for (auto _ : state) {
+        touched = 0;
+        for (const auto& [parent_tree, tree] : pairs) {
+            touched += Access::CommitTouchesPath(changelog, parent_tree.get(),
+                                                 tree.get(), path);
+        }
+    }
+    state.counters["touched"] = static_cast<double>(touched);
+    state.SetItemsProcessed(state.iterations() * pairs.size());
+}
+
+void BM_ParseChangelogStructured(benchmark::State& state, std::size_t entries) {
+    std::string content = SyntheticChangelog(entries, kBenchUrl);
+    std::size_t parsed = 0;
+    for (auto _ : state) {
+        auto sections = Access::ParseChangelogStructured(content);
+        benchmark::DoNotOptimize(sections.data());
+        parsed = 0;
+        for (const auto& section : sections) parsed += section.entries.size();
+    }
+    state.counters["parsed"] = static_cast<double>(parsed);
+    state.SetItemsProcessed(state.iterations() * entries);
+    state.SetBytesProcessed(state.iterations() * content.size());
+}
+
+void BM_CategorizeCommit(benchmark::State& state) {
+    const std::vector<std::string> summaries = {
+        "feat: add a flag",
+        "feat(parser)!: drop the old format",
+        "fix(core): handle empty input",
+        "Fix typo in README",
+        "refactor: split the loader",
+        "docs: describe the cache",
+        "Merge branch 'topic' into main",
+        "chore(deps): bump spdlog",
+        "perf: avoid a copy",
+        "revert: undo the last change",
+        "deprecated: old flags",
+        "test: cover edge cases",
+        "Update CHANGELOG.md",
+        "addition of a new parser",
+    };
+    for (auto _ : state) {
+        for (const auto& summary : summaries) {
+            benchmark::DoNotOptimize(Access::CategorizeCommit(summary));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * summaries.size());
+}
+
+void BM_DetectInitialVersion(benchmark::State& state, const BenchOptions& options,
+                             std::size_t commits) {
+    std::string repo = EnsureSyntheticRepo(options.root, MakeSpec(options, commits));
+    Changelog changelog(MakeConfig(options, repo, 0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Access::DetectInitialVersion(changelog));
+    }
+    state.SetItemsProcessed(state.iterations() * options.tags);
+}
+
+void BM_Generate(benchmark::State& state, const BenchOptions& options,
+                 std::size_t commits, std::size_t follow) {
+    std::string repo = EnsureSyntheticRepo(options.root, MakeSpec(options, commits));
+    Changelog::Config config = MakeConfig(options, repo, follow);
+    for (auto _ : state) {
+        // Every run writes the changelog from scratch.
+        state.PauseTiming();
+        std::filesystem::remove(config.output);
+        state.ResumeTiming();
+
+        Changelog(config).Generate();
+    }
+    state.SetItemsProcessed(state.iterations() * commits);
+}
+
+std::vector<std::size_t> ParseSizes(std::string_view value) {
+    std::vector<std::size_t> sizes;
+    for (const auto& part : split(std::string(value), ",")) {
+        sizes.push_back(std::stoul(part));
+    }
+    return sizes;
+}
+
+// Parses the flags left over after Google Benchmark has taken its own.
+bool ParseOptions(int argc, char** argv, BenchOptions* options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::size_t eq = arg.find('=');
+        std::string_view name = arg.substr(0, eq);
+        std::string value(eq == std::string_view::npos ? "" : arg.substr(eq + 1));
+        try {
+            if (name == "--root") {
+                options->root = value;
+            } else if (name == "--commits") {
+                options->commits = ParseSizes(value);
+            } else if (name == "--changelog_entries") {
+                options->changelog_entries = ParseSizes(value);
+            } else if (name == "--fanout") {
+                options->fanout = std::stoul(value);
+            } else if (name == "--tags") {
+                options->tags = std::stoul(value);
+            } else if (name == "--follow") {
+                options->follow = std::stoul(value);
+            } else if (name == "--jobs") {
+                options->jobs = std::max(1, std::stoi(value));
+            } else if (name == "--pipeline_depth") {
+                options->pipeline_depth = std::stoul(value);
+            } else if (name == "--pipeline_batch") {
+                options->pipeline_batch = std::max<std::size_t>(1, std::stoul(value));
+            } else if (name == "--pack_order") {
+                options->pack_order = value.empty() || value == "true";
+            } else {
+                std::cerr << "Unknown flag " << arg << "\n";
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << name << ": " << value << "\n";
+            return false;
+        }
+    }
+    options->follow = std::min(options->follow, options->fanout);
+    return true;
+}
+
+void RegisterBenchmarks(const BenchOptions& options) {
+    for (std::size_t commits : options.commits) {
+        std::string n = std::to_string(commits);
+        benchmark::RegisterBenchmark(("BM_GetGitLogs/" + n).c_str(), BM_GetGitLogs,
+                                     options, commits, 0)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_GetGitLogsFollow/" + n).c_str(),
+                                     BM_GetGitLogs, options, commits, options.follow)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_StreamEntriesFollow/" + n).c_str(),
+                                     BM_StreamEntries, options, commits, options.follow)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_CommitTouchesPath/literal/" + n).c_str(),
+                                     BM_CommitTouchesPath, options, commits,
+                                     SyntheticDirName(0));
+        benchmark::RegisterBenchmark(("BM_CommitTouchesPath/glob/" + n).c_str(),
+                                     BM_CommitTouchesPath, options, commits,
+                                     SyntheticDirName(0) + "/*");
+        benchmark::RegisterBenchmark(("BM_DetectInitialVersion/" + n).c_str(),
+                                     BM_DetectInitialVersion, options, commits)
+            ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("BM_Generate/" + n).c_str(), BM_Generate, options,
+                                     commits, 0)
+            ->Unit(benchmark::kMillisecond);
+        benchmark::RegisterBenchmark(("BM_GenerateFollow/" + n).c_str(), BM_Generate,
+                                     options, commits, options.follow)
+            ->Unit(benchmark::kMillisecond);
+    }
+    for (std::size_t entries : options.changelog_entries) {
+        benchmark::RegisterBenchmark(
+            ("BM_ParseChangelogStructured/" + std::to_string(entries)).c_str(),
+            BM_ParseChangelogStructured, entries)
+            ->Unit(benchmark::kMicrosecond);
+    }
+    benchmark::RegisterBenchmark("BM_CategorizeCommit", BM_CategorizeCommit);
+}
+
+}  // namespace
+
+// Besides the usual --benchmark_* flags, accepts:
+//   --root=DIR                where synthetic repositories are kept between runs
+//   --commits=N[,N...]        history sizes, e.g. 10000,100000,1000000
+//   --changelog_entries=N[,N...]
+//   --fanout=N --tags=N --follow=N --jobs=N
+//   --pipeline_depth=N --pipeline_batch=N --pack_order[=true|false]
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        return 1;
+    }
+    spdlog::set_level(spdlog::level::warn);
+
+    RegisterBenchmarks(options);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <git2.h>
+#include <git2/sys/mempack.h>
+#include <git2/sys/odb_backend.h>
+
+#include "synthetic_repo.h"
+
+namespace {
+
+#define _CHECK_GIT2(error, msg)                                       \
+    if (error < 0) {                                                  \
+        const git_error* e = git_error_last();                        \
+        throw std::runtime_error(std::string(msg) + ": " +            \
+                                 (e ? e->message : "unknown error")); \
+    }
+
+// Objects are buffered in memory and written out as one packfile per chunk,
+// which is far quicker than millions of loose objects.
+constexpr std::size_t kCommitsPerPack = 50000;
+
+constexpr char kCompleteMarker[] = "bench-complete";
+
+// Summaries cycle through these; `%s` is replaced by the directory name.
+constexpr std::string_view kSummaryTemplates[] = {
+    "feat(%s): add option number",
+    "fix(%s): handle empty input",
+    "fix: correct off-by-one in %s",
+    "refactor(%s): split the loader",
+    "docs: describe %s",
+    "test(%s): cover the edge cases",
+    "perf(%s): avoid a copy",
+    "chore(%s): bump dependencies",
+    "Update %s",
+    "Merge branch 'topic' into main",
+    "add: new %s module",
+    "deprecated: old %s flags",
+    "revert: undo %s change",
+    "ci: tweak %s workflow",
+    "WIP %s",
+    "style: format %s",
+};
+
+// Deterministic stand-in for a random choice of directory.
+std::size_t Mix(std::size_t i) {
+    std::uint64_t x = i * 0x9E3779B97F4A7C15ull;
+    x ^= x >> 29;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 32;
+    return static_cast<std::size_t>(x);
+}
+
+std::string RepoDirName(const SyntheticRepoSpec& spec) {
+    return "c" + std::to_string(spec.commits) + "_f" + std::to_string(spec.fanout) +
+           "_d" + std::to_string(spec.files_per_dir) + "_t" +
+           std::to_string(spec.tags) + "_a" + std::to_string(spec.authors) + ".git";
+}
+
+std::string Summary(std::size_t i, const std::string& dir) {
+    std::string_view tmpl = kSummaryTemplates[i % std::size(kSummaryTemplates)];
+    std::string summary;
+    std::size_t at = tmpl.find("%s");
+    if (at == std::string_view::npos) {
+        summary = tmpl;
+    } else {
+        summary.append(tmpl.substr(0, at)).append(dir).append(tmpl.substr(at + 2));
+    }
+    summary += " #" + std::to_string(i);
+    // A sprinkling of breaking changes keeps the major-bump path exercised.
+    std::size_t colon = summary.find(':');
+    if (i % 997 == 0 && colon != std::string::npos) summary.insert(colon, "!");
+    return summary;
+}
+
+std::string TagName(std::size_t k) {
+    std::size_t n = k / 4;
+    std::string version = std::to_string(n / 400) + "." + std::to_string(n / 20 % 20) +
+                          "." + std::to_string(n % 20);
+    switch (k % 4) {
+        case 0:
+            return "v" + version;
+        case 1:
+            return "v" + version + "-rc1";
+        case 2:
+            return "nightly-" + std::to_string(k);
+        default:
+            return "pkg" + std::to_string(k % 7) + "@v" + version;
+    }
+}
+
+// A raw tree object whose entries are patched in place as the history is
+// generated. Entry names have a fixed width, so the entries stay sorted and
+// every OID keeps its offset.
+class TreeImage {
+   public:
+    void Add(const char* mode, const std::string& name, const git_oid& oid) {
+        data_.append(mode).append(" ").append(name).push_back('\0');
+        offsets_.push_back(data_.size());
+        data_.append(reinterpret_cast<const char*>(oid.id), GIT_OID_SHA1_SIZE);
+    }
+
+    void Set(std::size_t index, const git_oid& oid) {
+        data_.replace(offsets_[index], GIT_OID_SHA1_SIZE,
+                      reinterpret_cast<const char*>(oid.id), GIT_OID_SHA1_SIZE);
+    }
+
+    git_oid Write(git_odb* odb) const {
+        git_oid oid;
+        _CHECK_GIT2(
+            git_odb_write(&oid, odb, data_.data(), data_.size(), GIT_OBJECT_TREE),
+            "Failed to write tree");
+        return oid;
+    }
+
+   private:
+    std::string data_;
+    std::vector<std::size_t> offsets_;
+};
+
+std::string FileName(std::size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "f%04zu.txt", index);
+    return name;
+}
+
+std::string Hex(const git_oid& oid) {
+    char hex[GIT_OID_SHA1_HEXSIZE + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+    return hex;
+}
+
+void FlushPack(git_repository* repo, git_odb* odb, git_odb_backend* mempack) {
+    git_buf pack = GIT_BUF_INIT;
+    _CHECK_GIT2(git_mempack_dump(&pack, repo, mempack), "Failed to build packfile");
+
+    git_odb_writepack* writepack = nullptr;
+    int e = git_odb_write_pack(&writepack, odb, nullptr, nullptr);
+    if (e == 0) {
+        git_indexer_progress stats = {};
+        e = writepack->append(writepack, pack.ptr, pack.size, &stats);
+        if (e == 0) e = writepack->commit(writepack, &stats);
+        writepack->free(writepack);
+    }
+    git_buf_dispose(&pack);
+    _CHECK_GIT2(e, "Failed to write packfile");
+    _CHECK_GIT2(git_mempack_reset(mempack), "Failed to reset object buffer");
+}
+
+void GenerateRepo(const std::string& path, const SyntheticRepoSpec& spec) {
+    if (spec.commits == 0 || spec.fanout == 0 || spec.files_per_dir == 0 ||
+        spec.authors == 0) {
+        throw std::runtime_error("Synthetic repositories need at least one of each");
+    }
+    std::filesystem::remove_all(path);
+
+    git_repository* repo = nullptr;
+    _CHECK_GIT2(git_repository_init(&repo, path.c_str(), /*is_bare=*/1),
+                "Failed to create repository at " + path);
+    git_odb* odb = nullptr;
+    git_odb_backend* mempack = nullptr;
+    try {
+        _CHECK_GIT2(git_repository_odb(&odb, repo), "Failed to open object database");
+        _CHECK_GIT2(git_mempack_new(&mempack), "Failed to create object buffer");
+        // The odb takes ownership of the backend.
+        int e = git_odb_add_backend(odb, mempack, 1000);
+        if (e < 0) mempack->free(mempack);
+        _CHECK_GIT2(e, "Failed to add object buffer");
+
+        git_oid initial_blob;
+        _CHECK_GIT2(git_odb_write(&initial_blob, odb, "0\n", 2, GIT_OBJECT_BLOB),
+                    "Failed to write blob");
+        TreeImage dir_template;
+        for (std::size_t f = 0; f < spec.files_per_dir; ++f) {
+            dir_template.Add("100644", FileName(f), initial_blob);
+        }
+        std::vector<TreeImage> dirs(spec.fanout, dir_template);
+        git_oid initial_dir = dir_template.Write(odb);
+        TreeImage root;
+        for (std::size_t d = 0; d < spec.fanout; ++d) {
+            root.Add("40000", SyntheticDirName(d), initial_dir);
+        }
+
+        // Commit index of tag k; several tags may share a commit.
+        std::vector<std::size_t> tag_positions(spec.tags);
+        for (std::size_t k = 0; k < spec.tags; ++k) {
+            tag_positions[k] = (k + 1) * spec.commits / (spec.tags + 1);
+        }
+        std::vector<git_oid> tag_targets(spec.tags);
+        std::size_t next_tag = 0;
+
+        git_oid head = {};
+        std::string raw;
+        for (std::size_t i = 0; i < spec.commits; ++i) {
+            std::string summary;
+            if (i == 0) {
+                summary = "chore: initial import";
+            } else {
+                std::size_t d = Mix(i) % spec.fanout;
+                std::size_t f = i % spec.files_per_dir;
+                std::string content = std::to_string(i) + "\n";
+                git_oid blob;
+                _CHECK_GIT2(git_odb_write(&blob, odb, content.data(), content.size(),
+                                          GIT_OBJECT_BLOB),
+                            "Failed to write blob");
+                dirs[d].Set(f, blob);
+                root.Set(d, dirs[d].Write(odb));
+                summary = Summary(i, SyntheticDirName(d));
+            }
+
+            std::size_t author = Mix(i + 1) % spec.authors;
+            std::string signature = "Author " + std::to_string(author) + " <author" +
+                                    std::to_string(author) + "@example.com> " +
+                                    std::to_string(1500000000 + i * 60) + " +0000\n";
+            raw = "tree " + Hex(root.Write(odb)) + "\n";
+            if (i > 0) raw += "parent " + Hex(head) + "\n";
+            raw += "author " + signature + "committer " + signature + "\n" + summary +
+                   "\n\nGenerated for benchmarking.\n";
+            _CHECK_GIT2(
+                git_odb_write(&head, odb, raw.data(), raw.size(), GIT_OBJECT_COMMIT),
+                "Failed to write commit");
+
+            while (next_tag < spec.tags && tag_positions[next_tag] == i) {
+                tag_targets[next_tag++] = head;
+            }
+            if ((i + 1) % kCommitsPerPack == 0 || i + 1 == spec.commits) {
+                FlushPack(repo, odb, mempack);
+                std::fprintf(stderr, "Generated %zu/%zu commits in %s\n", i + 1,
+                             spec.commits, path.c_str());
+            }
+        }
+
+        git_reference* ref = nullptr;
+        _CHECK_GIT2(git_reference_create(&ref, repo, "refs/heads/main", &head,
+                                         /*force=*/1, "bench: seed"),
+                    "Failed to create branch");
+        git_reference_free(ref);
+        _CHECK_GIT2(git_repository_set_head(repo, "refs/heads/main"),
+                    "Failed to set HEAD");
+
+        // Tens of thousands of loose refs would dominate the tag scan, so
+        // write them packed the way `git pack-refs` would.
+        std::ofstream packed(path + "/packed-refs", std::ios::binary | std::ios::app);
+        packed << "# pack-refs with: peeled \n";
+        for (std::size_t k = 0; k < spec.tags; ++k) {
+            packed << Hex(tag_targets[k]) << " refs/tags/" << TagName(k) << "\n";
+        }
+        if (!packed.flush()) {
+            throw std::runtime_error("Failed to write " + path + "/packed-refs");
+        }
+    } catch (...) {
+        git_odb_free(odb);
+        git_repository_free(repo);
+        throw;
+    }
+    git_odb_free(odb);
+    git_repository_free(repo);
+
+    std::ofstream(path + "/" + kCompleteMarker) << RepoDirName(spec) << "\n";
+}
+
+}  // namespace
+
+std::string SyntheticDirName(std::size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "pkg%04zu", index);
+    return name;
+}
+
+std::string EnsureSyntheticRepo(const std::string& root,
+                                const SyntheticRepoSpec& spec) {
+    std::string path = root + "/" + RepoDirName(spec);
+    if (!std::filesystem::exists(path + "/" + kCompleteMarker)) {
+        std::filesystem::create_directories(root);
+        GenerateRepo(path, spec);
+    }
+    return path;
+}
+
+std::string SyntheticChangelog(std::size_t entries, const std::string& url) {
+    constexpr std::size_t kEntriesPerSection = 50;
+    constexpr std::string_view kTypeHeadings[] = {"Feat", "Fix", "Refactor", "Docs",
+                                                  "Perf"};
+    std::size_t old_format_from = entries - entries / 10;
+
+    std::string out = "# Changelog\n\n";
+    for (std::size_t i = 0; i < entries; ++i) {
+        if (i % kEntriesPerSection == 0) {
+            std::size_t section = i / kEntriesPerSection;
+            std::size_t version = entries / kEntriesPerSection - section;
+            out += "## bench@v" + std::to_string(version / 100) + "." +
+                   std::to_string(version % 100) + ".0 — 2024-01-" +
+                   std::to_string(10 + section % 20) + "\n\n";
+        }
+        std::size_t in_section = i % kEntriesPerSection;
+        std::size_t per_type = kEntriesPerSection / std::size(kTypeHeadings);
+        if (in_section % per_type == 0) {
+            std::string_view heading = kTypeHeadings[in_section / per_type];
+            out.append("### ").append(heading).append("\n\n");
+        }
+
+        git_oid oid = {};
+        for (std::size_t b = 0; b < GIT_OID_SHA1_SIZE; b += 8) {
+            std::uint64_t word = Mix(i * 3 + b);
+            std::size_t bytes = std::min<std::size_t>(8, GIT_OID_SHA1_SIZE - b);
+            for (std::size_t j = 0; j < bytes; ++j) {
+                oid.id[b + j] = (word >> (j * 8)) & 0xff;
+            }
+        }
+        std::string full = Hex(oid);
+        std::string link =
+            "[#" + full.substr(0, 7) + "](" + url + "/commit/" + full + ")";
+        std::string summary = "change number " + std::to_string(i);
+        if (i < old_format_from) {
+            out += "- " + summary + " by **Author " + std::to_string(i % 200) +
+                   "** in " + link + "\n";
+        } else {
+            out += "- " + summary + " (" + link + ")\n";
+        }
+        if ((in_section + 1) % per_type == 0) out += "\n";
+        if (in_section + 1 == kEntriesPerSection) out += "\n";
+    }
+    return out;
+}
@@ -0,0 +1,30 @@
+#ifndef CHANGELOG_BENCH_SYNTHETIC_REPO_H_
+#define CHANGELOG_BENCH_SYNTHETIC_REPO_H_
+
+#include <cstddef>
+#include <string>
+
+// Shape of a generated repository. The history is linear; every commit after
+// the first rewrites one file in one of `fanout` top-level directories.
+struct SyntheticRepoSpec {
+    std::size_t commits = 10000;
+    std::size_t fanout = 16;
+    std::size_t files_per_dir = 8;
+    // Lightweight tags spread evenly over the history. Every fourth one is a
+    // plain semantic version, the rest are pre-releases and nightly tags.
+    std::size_t tags = 100;
+    std::size_t authors = 200;
+};
+
+// Name of the `index`-th top-level directory, e.g. "pkg0003".
+std::string SyntheticDirName(std::size_t index);
+
+// Returns the path of a bare repository under `root` matching `spec`,
+// generating it first unless a complete one is already there.
+std::string EnsureSyntheticRepo(const std::string& root, const SyntheticRepoSpec& spec);
+
+// Renders a CHANGELOG.md holding `entries` entries, most in the current format
+// and the oldest tenth in the v0.1.0 one.
+std::string SyntheticChangelog(std::size_t entries, const std::string& url);
+
+#endif  // CHANGELOG_BENCH_SYNTHETIC_REPO_H_
@@ -0,0 +1,73 @@
+#ifndef CHANGELOG_BOUNDED_QUEUE_H_
+#define CHANGELOG_BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+// Blocking FIFO of at most `capacity` items, connecting the stages of a
+// pipeline. Any number of threads may push and pop. Producers block while it
+// is full, so a slow stage holds the ones before it back instead of letting
+// work pile up in memory.
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Blocks until there is room. Returns false, dropping `item`, once the
+    // queue is closed.
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_ || closed_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Blocks until an item arrives. Returns nothing once the queue is closed
+    // and every item pushed before has been popped.
+    std::optional<T> Pop() {
+        std::unique_lock<std::mutex> lock(mu_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return std::nullopt;
+        T item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return item;
+    }
+
+    // Ends the stream: pushes fail from now on, pops drain what is left.
+    void Close() {
+        std::lock_guard<std::mutex> lock(mu_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    // Closes the queue and drops everything in it, for when the consumer
+    // has given up.
+    void Cancel() {
+        std::lock_guard<std::mutex> lock(mu_);
+        closed_ = true;
+        items_.clear();
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+   private:
+    const std::size_t capacity_;
+    std::mutex mu_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+#endif  // CHANGELOG_BOUNDED_QUEUE_H_
@@ -1,49 +1,150 @@
 #ifndef CHANGELOG_H_
 #define CHANGELOG_H_
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include <git2.h>
+#include <spdlog/fmt/fmt.h>
 
+#include "commit_graph.h"
+#include "commit_type.h"
+#include "path_trie.h"
+#include "stats.h"
+#include "utils.h"
 #include "version.h"
 
-enum class CommitType {
-    kAdd,
-    kFeat,
-    kRefactor,
-    kRevert,
-    kDeprecated,
-    kFix,
-    kDocs,
-    kTest,
-    kPerf,
+// What a commit summary says about the commit, worked out in one scan.
+struct SummaryClass {
+    std::optional<CommitType> type;
+    bool breaking = false;
 };
 
-const std::map<CommitType, std::string>& CommitTypeNames();
-const std::map<std::string, CommitType>& PrefixToCommitType();
-
+// A recorded commit. The strings are views into storage owned by whoever
+// produced the entry: the Changelog's arena for commits read from the
+// repository, or the parsed changelog text for entries read back from it.
 struct CommitEntry {
-    const std::string summary;
+    const std::string_view summary;
     const git_oid oid;
-    const std::string author_name;
+    const std::string_view author_name;
+
+    // Output order: by summary, with the OID keeping distinct commits that
+    // share a summary apart.
+    bool operator<(const CommitEntry& o) const {
+        int cmp = summary.compare(o.summary);
+        return cmp != 0 ? cmp < 0 : git_oid_cmp(&oid, &o.oid) < 0;
+    }
+};
+
+// Object IDs are SHA-1 digests, so any eight bytes of one are already a
+// well-distributed hash.
+struct GitOidHash {
+    std::size_t operator()(const git_oid& oid) const {
+        std::size_t h;
+        std::memcpy(&h, oid.id, sizeof(h));
+        return h;
+    }
+};
 
-    bool operator<(const CommitEntry& o) const { return summary < o.summary; }
+struct GitOidEqual {
+    bool operator()(const git_oid& a, const git_oid& b) const {
+        return git_oid_equal(&a, &b);
+    }
 };
 
-// commit_type -> set<formatted_entry>
-using SectionEntries = std::map<CommitType, std::set<CommitEntry>>;
+using OidSet = std::unordered_set<git_oid, GitOidHash, GitOidEqual>;
+
+// What GetGitLogs works out for a single commit. `summary` and `author_name`
+// are only filled in when the commit is categorized or breaking, and
+// `touches` holds one flag per followed path.
+struct CommitInfo {
+    std::optional<CommitType> type;
+    bool breaking = false;
+    std::string summary;
+    std::string author_name;
+    std::vector<bool> touches;
+};
+
+class CommitCache;
+class EntrySpill;
+
+// commit_type -> set<formatted_entry>, stored densely by CommitTypeIndex().
+struct SectionEntries {
+    std::array<std::set<CommitEntry>, kCommitTypeCount> by_type;
+
+    std::set<CommitEntry>& operator[](CommitType type) {
+        return by_type[CommitTypeIndex(type)];
+    }
+    const std::set<CommitEntry>& operator[](CommitType type) const {
+        return by_type[CommitTypeIndex(type)];
+    }
+
+    bool empty() const {
+        for (const auto& logs : by_type) {
+            if (!logs.empty()) return false;
+        }
+        return true;
+    }
+
+    std::size_t size() const {
+        std::size_t count = 0;
+        for (const auto& logs : by_type) count += logs.size();
+        return count;
+    }
+
+    // Types that have at least one entry.
+    CommitTypeSet types() const {
+        CommitTypeSet set;
+        for (std::size_t i = 0; i < kCommitTypeCount; ++i) {
+            set[i] = !by_type[i].empty();
+        }
+        return set;
+    }
+};
 
 struct SectionData {
     SectionEntries entries;
     bool has_breaking_change = false;
+    // Under Changelog::Config::memory_limit the entries are streamed from this
+    // section of an EntrySpill instead, `entries` stays empty and
+    // `spilled_counts` holds how many there are of each type.
+    std::optional<std::size_t> spilled;
+    std::array<std::size_t, kCommitTypeCount> spilled_counts = {};
+
+    // Entries wherever they are kept.
+    std::size_t size() const {
+        std::size_t count = entries.size();
+        for (std::size_t n : spilled_counts) count += n;
+        return count;
+    }
+
+    // Types that have at least one entry, wherever they are kept.
+    CommitTypeSet types() const {
+        CommitTypeSet set = entries.types();
+        for (std::size_t i = 0; i < kCommitTypeCount; ++i) {
+            set[i] = set[i] || spilled_counts[i] > 0;
+        }
+        return set;
+    }
 };
 
 struct ParsedSection {
+    // The whole "## " line, without its newline, as a view into the parsed
+    // text.
+    std::string_view header;
     std::string name;
     std::optional<SemanticVersion> version;
     std::string date;
@@ -59,10 +160,58 @@ class Changelog {
    public:
     struct Config {
         std::string repo = ".";
+        // Open `repo` as a git directory, such as a bare mirror, without
+        // looking for a working tree or searching its parent directories.
+        bool bare = false;
         std::string output = "CHANGELOG.md";
         std::string repo_name;
         std::string url;
         std::vector<std::string> follow;
+        // Only walk commits newer than those already in `output`. Assumes
+        // `follow` is unchanged since the changelog was last generated.
+        bool incremental = false;
+        // Path of the commit classification cache; empty disables it.
+        std::string cache;
+        // Keep a ChangelogIndex next to each output, so an unchanged changelog
+        // is not parsed on the next run.
+        bool index = true;
+        // Number of threads loading and classifying commits.
+        int jobs = 1;
+        // Batches each stage of the collection pipeline may queue for the
+        // next; 0 keeps collection on the calling thread and the --jobs
+        // workers. See ClassifyPipelined().
+        std::size_t pipeline_depth = 0;
+        // Commits handed from one pipeline stage to the next at a time.
+        std::size_t pipeline_batch = 256;
+        // Load commits in packfile order rather than walk order, which turns
+        // scattered reads into near-sequential ones on a cold page cache.
+        bool pack_order = false;
+        // Leave out the commits reachable from this revision, e.g. a tag.
+        std::string since;
+        // Walk "A..B" instead of HEAD.
+        std::string range;
+        // Stop after this many commits, newest first; 0 means no limit.
+        std::size_t max_count = 0;
+        // Rebuild each changelog from the history, with one section per
+        // semver tag holding the commits that tag released first, instead of
+        // adding to what `output` already records.
+        bool by_tag = false;
+        // Bytes the collected entries may take in memory; 0 means no limit.
+        // Beyond it, sorted runs of them are spilled to a temporary file and
+        // merged once before the changelogs are written. The walk's own
+        // per-commit state, such as the release of each commit with
+        // `by_tag` or the load order with `pack_order`, is not bounded.
+        std::size_t memory_limit = 0;
+        // Also write each changelog's new sections as JSON Lines and in a
+        // compact binary format, next to it with a .jsonl and a .bin
+        // extension. Both start with a checksum of the markdown they match;
+        // for JSON Lines that is a first line {"markdown_checksum":"..."}.
+        // The binary layout is described in changelog.cc.
+        bool jsonl = false;
+        bool binary = false;
+        // Keep the individual timer spans for Stats::WriteTraceJson(), not
+        // just their per-phase totals.
+        bool trace = false;
     };
 
     explicit Changelog(Config config);
@@ -73,40 +222,321 @@ class Changelog {
 
     void Generate();
 
+    // One changelog of a batch: where it is written and which paths it
+    // follows. No paths means the whole repository.
+    struct Target {
+        std::string output;
+        std::vector<std::string> follow;
+    };
+
+    // Like Generate(), but for many targets at once. They share one walk of
+    // the history, one cache and one tag scan, and are written in parallel.
+    // `config.output` and `config.follow` are ignored.
+    void GenerateBatch(const std::vector<Target>& targets);
+
+    // Parses a batch manifest: one target per line, the output path followed
+    // by the paths it follows, separated by whitespace. Blank lines and lines
+    // starting with '#' are skipped.
+    static std::vector<Target> ParseManifest(std::string_view content);
+
+    // Generates `targets`, then keeps their parsed state resident and folds
+    // in the commits added since the last seen HEAD whenever it moves. Ref
+    // changes are picked up through the filesystem where supported, and
+    // HEAD is rechecked at least every `poll_interval`. Returns once
+    // `should_stop` does, which is checked after every wakeup. The stats are
+    // reset before each update, so afterwards they describe the last one.
+    // Config::range and Config::max_count must be unset, as they fix the set
+    // of commits.
+    void Watch(const std::vector<Target>& targets,
+               std::chrono::milliseconds poll_interval,
+               const std::function<bool()>& should_stop);
+
+    // A categorized commit of one section, as StreamEntries() finds it.
+    struct StreamedEntry {
+        // Its strings are only valid during the callback.
+        CommitEntry entry;
+        CommitType type;
+        bool breaking;
+        // Index into the followed paths, or their count for the section of
+        // the whole repository.
+        std::size_t section;
+    };
+
+    using EntryCallback = std::function<void(const StreamedEntry&)>;
+
+    // Walks the history as Generate() would for `follow`, honouring the
+    // bounds and collection settings of the config, but hands every entry to
+    // `callback` as soon as its commit is classified instead of writing a
+    // changelog. A commit touching several followed paths comes once per
+    // section. With `include_all` or with no paths, the whole repository is a
+    // section too. `callback` runs on the calling thread, in walk order
+    // whatever the collection settings, and may throw to stop the walk. With
+    // Config::pack_order that means holding back entries until the commits
+    // walked before them are classified.
+    void StreamEntries(const std::vector<std::string>& follow,
+                       const EntryCallback& callback, bool include_all = false);
+
+    // Timings and counters of everything done so far.
+    const Stats& stats() const { return stats_; }
+
    private:
-    SectionData GetGitLogs(const std::string& follow = "");
+    // Lets bench/changelog_bench.cc time the individual stages.
+    friend struct ChangelogBenchAccess;
+    friend struct ChangelogTestAccess;
+
+    // A semver tag and the commit it points at.
+    struct Release {
+        SemanticVersion version;
+        git_oid commit;
+        // Day of the tagged commit, like the dates of other sections.
+        std::string date;
+    };
+
+    // One release per semver version among the tags that name a commit,
+    // oldest version first.
+    std::vector<Release> ListReleases() const;
+
+    // Walks the history once and returns one SectionData per entry of
+    // `follow`, in the same order. With `include_all` or with no paths, a
+    // trailing section holding every commit is added. Commits in `hidden` and
+    // their ancestors are not visited. Commits found in `cache` are not loaded
+    // from the repository.
+    //
+    // With `releases`, that group of sections is repeated once per release and
+    // once more for the commits no tag reaches, and each commit goes to the
+    // group of the oldest release whose tag reaches it.
+    std::vector<SectionData> GetGitLogs(const std::vector<std::string>& follow = {},
+                                        const OidSet& hidden = {},
+                                        CommitCache* cache = nullptr,
+                                        bool include_all = false,
+                                        const std::vector<Release>& releases = {});
+
+    // Gets each categorized or breaking commit the walk classifies, with the
+    // index into its `releases` of the release it shipped in, or
+    // releases.size() for unreleased ones.
+    using WalkSink =
+        std::function<void(const git_oid&, const CommitInfo&, std::size_t release)>;
+
+    // The walk behind GetGitLogs() and StreamEntries(). With `reject`, commits
+    // the commit-graph shows to leave every followed path alone are skipped
+    // before being loaded. With `in_walk_order`, `sink` gets the commits in
+    // walk order even when Config::pack_order loads them in another.
+    void WalkHistory(const std::vector<std::string>& follow_paths,
+                     const OidSet& hidden, CommitCache* cache, bool reject,
+                     const std::vector<Release>& releases, bool in_walk_order,
+                     const WalkSink& sink);
 
-    std::string FormatChangelog(
+    // Bloom filter keys of the followed paths, one per path, or none at all
+    // without a commit-graph. Paths the filters can't answer have no key.
+    using PathKeys = std::vector<std::optional<CommitGraph::PathKey>>;
+
+    // The followed paths of a walk, compiled once for every commit in it.
+    struct FollowSet {
+        std::vector<std::string> paths;
+        PathKeys keys;
+        // The literal paths; the others are matched with a diff each.
+        PathTrie trie;
+    };
+
+    FollowSet MakeFollowSet(const std::vector<std::string>& follow_paths) const;
+
+    // True when the commit-graph shows that `oid` touches none of the paths
+    // of `keys`, so that the commit need not be loaded at all.
+    bool RejectedByBloom(const git_oid& oid, const PathKeys& keys) const;
+
+    // Loads `oid` from `repo` and works out everything GetGitLogs needs to
+    // know about it. `repo` is repo_ or a worker's own handle, and `odb` its
+    // object database, opened once by the caller. Paths that the filters of
+    // `follow.keys` rule out are not looked up in the trees.
+    CommitInfo ClassifyCommit(git_repository* repo, git_odb* odb, const git_oid& oid,
+                              const FollowSet& follow) const;
+
+    using CommitSink = std::function<void(const git_oid&, const CommitInfo&)>;
+
+    // Produces the commits to classify, one per call. Returns false once
+    // there are no more.
+    using CommitSource = std::function<bool(git_oid*)>;
+
+    // Classifies the commits produced by `next` on config_.jobs worker
+    // threads and hands them to `sink` on the calling thread, in the order
+    // `next` produced them.
+    void ClassifyInParallel(const CommitSource& next,
+                            const FollowSet& follow, CommitCache* cache,
+                            const CommitSink& sink) const;
+
+    // Runs collection as a pipeline of stages on their own threads: pulling
+    // from `next`, object loading and inflating, classification on
+    // config_.jobs threads, and aggregation into `sink` on the calling
+    // thread. Adjacent stages are connected by queues config_.pipeline_depth
+    // batches deep, so reads overlap with classification. `sink` gets the
+    // commits in the order `next` produced them.
+    void ClassifyPipelined(const CommitSource& next,
+                           const FollowSet& follow, CommitCache* cache,
+                           const CommitSink& sink) const;
+
+    // Index into `releases` of the release each commit shipped in, or
+    // releases.size() for unreleased ones.
+    using ReleaseMap =
+        std::unordered_map<git_oid, std::uint32_t, GitOidHash, GitOidEqual>;
+
+    // Drains `walk`, which must produce children before their parents, into
+    // the returned list and fills `release_of` for every commit in it. A
+    // release reaches what its tagged commit does, so each released commit
+    // hands its release down to its parents unless they already have an
+    // older one.
+    std::vector<git_oid> AssignReleases(const CommitSource& walk,
+                                        const std::vector<Release>& releases,
+                                        ReleaseMap* release_of) const;
+
+    // Drains `next` and orders the commits by the packfile and offset they
+    // are stored at, so loading them reads each pack front to back instead
+    // of jumping around in walk order. Unpacked commits come last. If given,
+    // `walk_positions` gets the position in `next` of each returned commit.
+    std::vector<git_oid> CollectInPackOrder(
+        const CommitSource& next,
+        std::vector<std::size_t>* walk_positions = nullptr) const;
+
+    // Works out what ClassifyCommit() does from the commit's raw object
+    // `data`, read beforehand.
+    CommitInfo ClassifyCommitData(git_repository* repo, git_odb* odb,
+                                  const git_oid& oid, std::string_view data,
+                                  const FollowSet& follow) const;
+
+    // Advances `walker`, honouring config_.max_count; `walked` counts the
+    // commits returned so far.
+    bool NextCommit(git_revwalk* walker, git_oid* oid, std::size_t* walked) const;
+
+    // Resolves a revision such as a tag name to the commit it names.
+    git_oid ResolveCommit(const std::string& rev) const;
+
+    git_repository* OpenRepository() const;
+
+    struct ExistingChangelog;
+
+    // The union of the targets' followed paths, walked once. `index[t]` maps
+    // the paths of target t into it; targets without paths use the trailing
+    // whole-repository section that `whole_repo` asks for.
+    struct WalkPlan {
+        std::vector<std::string> paths;
+        std::vector<std::vector<std::size_t>> index;
+        bool whole_repo = false;
+    };
+
+    static WalkPlan PlanWalk(const std::vector<Target>& targets);
+    std::vector<ExistingChangelog> LoadExisting(const std::vector<Target>& targets);
+    static OidSet RecordedByAll(const std::vector<ExistingChangelog>& existing);
+
+    // Collects the commits not in `hidden` and writes every target. With
+    // `retain`, each of `existing` becomes what was written for it. With
+    // `releases`, the commits are sectioned by release as well.
+    void UpdateTargets(const std::vector<Target>& targets, const WalkPlan& plan,
+                       std::vector<ExistingChangelog>& existing, const OidSet& hidden,
+                       CommitCache* cache, bool retain,
+                       const std::vector<Release>& releases = {});
+
+    // The sections of one changelog, by section name.
+    using SectionGroup = std::map<std::string, const SectionData*>;
+
+    // Adds the new entries of `current` to `existing` and writes the result
+    // to `output`. `current` holds one group per release of `releases`, then
+    // the unreleased one. Runs on the batch writer threads.
+    // `head` goes into the sidecar; see ChangelogIndex::head().
+    void WriteTarget(const std::string& output, ExistingChangelog& existing,
+                     const std::vector<SectionGroup>& current,
+                     const std::vector<Release>& releases, const SemanticVersion& seed,
+                     const std::string& today, const git_oid& head, bool retain);
+
+    git_oid HeadOid() const;
+
+    // Directories whose entries change when HEAD or the branch it is on moves.
+    std::vector<std::string> RefDirectories() const;
+
+    // Appends `sections`, all dated `date`, to `out`. Entries of spilled
+    // sections are streamed from spill_, leaving out those `existing`
+    // records. With `file`, `out` is flushed to it whenever it fills up.
+    void FormatChangelog(
+        fmt::memory_buffer* out,
         const std::vector<std::pair<std::string, SectionData>>& sections,
-        const std::string& date);
+        const std::string& date, const ExistingChangelog& existing,
+        AtomicFileWriter* file = nullptr) const;
+
+    // Appends one "### Type" block per type present in `data`.
+    void FormatEntries(fmt::memory_buffer* out, const SectionData& data,
+                       const ExistingChangelog& existing, AtomicFileWriter* file) const;
+
+    // Calls `fn` for each entry of `type` in `data`. Those of a spilled
+    // section are streamed from spill_, leaving out the ones `existing`
+    // records.
+    void ForEachEntry(const SectionData& data, CommitType type,
+                      const ExistingChangelog& existing,
+                      const std::function<void(const CommitEntry&)>& fn) const;
+
+    // Sections formatted together, all dated `date`.
+    struct DatedSections {
+        const std::vector<std::pair<std::string, SectionData>>* sections;
+        std::string_view date;
+    };
+
+    // Writes the companions of `output` that the config asks for, once the
+    // markdown, whose MarkdownChecksum() is `new_checksum`, has been written.
+    // `groups` go in front of what an earlier run wrote if that matches
+    // `existing`, and replace it when `existing` has no body. A companion that
+    // does not match is rebuilt from all of `output`.
+    void WriteFormats(const std::string& output, std::uint64_t new_checksum,
+                      const std::vector<DatedSections>& groups,
+                      const ExistingChangelog& existing) const;
+
+    // Append one JSON object per entry of `group`, one per line, or its
+    // sections in the binary format, flushing `out` to `file` as it fills.
+    void FormatJsonLines(fmt::memory_buffer* out, const DatedSections& group,
+                         const ExistingChangelog& existing,
+                         AtomicFileWriter* file) const;
+    void FormatBinary(fmt::memory_buffer* out, const DatedSections& group,
+                      const ExistingChangelog& existing, AtomicFileWriter* file) const;
 
-    static std::string ReadChangelogFile(const std::string& fpath);
+    // Returns `content` without its leading "# Changelog" line.
+    static std::string_view ChangelogBody(std::string_view content);
 
-    static std::vector<ParsedSection> ParseChangelogStructured(
-        const std::string& content);
+    // The entries of the returned sections point into `content`, which must
+    // outlive them.
+    static std::vector<ParsedSection> ParseChangelogStructured(std::string_view content);
 
-    static std::set<CommitEntry> FlattenEntries(
-        const std::vector<ParsedSection>& sections);
+    // Collects the OIDs of every entry already recorded in `sections`.
+    static OidSet FlattenEntries(const std::vector<ParsedSection>& sections);
 
-    static SectionData FilterNewEntries(const SectionData& current,
-                                        const std::set<CommitEntry>& existing_entries);
+    // The entries of `current` that `existing` does not record yet. Those of
+    // a spilled section are only counted, and stay in spill_.
+    SectionData FilterNewEntries(const SectionData& current,
+                                 const ExistingChangelog& existing) const;
 
-    static std::optional<CommitType> CategorizeCommit(const std::string& summary);
-    static bool IsBreakingChange(const std::string& summary);
+    static SummaryClass ClassifySummary(std::string_view summary);
+    static std::optional<CommitType> CategorizeCommit(std::string_view summary);
+    static bool IsBreakingChange(std::string_view summary);
 
-    static std::string ShortHash(const git_oid* oid);
     static std::string FullHash(const git_oid* oid);
     static std::string FormatDate(git_time_t time);
 
     SemanticVersion DetectInitialVersion() const;
 
-    bool CommitTouchesPath(git_commit* commit, const std::string& path) const;
+    bool CommitTouchesPath(git_repository* repo, git_tree* parent_tree,
+                           git_tree* commit_tree, const std::string& path) const;
 
     std::string SSH2HTTPS(const std::string url);
-    std::string FormatEntry(const CommitEntry& entry);
+    // Appends the list item of `entry`, newline included.
+    void FormatEntry(fmt::memory_buffer* out, const CommitEntry& entry) const;
 
     Config config_;
     git_repository* repo_ = nullptr;
+    // The repository's commit-graph, if it has one; read-only, so workers
+    // share it.
+    std::unique_ptr<CommitGraph> graph_;
+    // Backs the strings of every CommitEntry collected from the repository.
+    StringArena arena_;
+    // Holds the entries of the sections being written under
+    // Config::memory_limit instead; null otherwise.
+    std::unique_ptr<EntrySpill> spill_;
+    // Thread-safe, so const members and workers update it too.
+    mutable Stats stats_;
 };
 
 #endif  // CHANGELOG_H_
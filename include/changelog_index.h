@@ -0,0 +1,80 @@
+#ifndef CHANGELOG_CHANGELOG_INDEX_H_
+#define CHANGELOG_CHANGELOG_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <git2.h>
+
+#include "utils.h"
+#include "version.h"
+
+// Binary sidecar of a changelog, holding what a run needs to know about the
+// markdown without parsing it: the sorted OIDs of every recorded entry, the
+// offsets of the section headers, the version of the newest section and the
+// HEAD the changelog was generated from.
+//
+// The sidecar is tied to the exact bytes of the markdown by their size and
+// checksum. Once the changelog is edited by hand it no longer matches, and the
+// markdown is parsed again.
+class ChangelogIndex {
+   public:
+    // An index that matches nothing.
+    ChangelogIndex() = default;
+
+    // Maps the sidecar at `path`, and keeps it only if it was written for
+    // `content`.
+    ChangelogIndex(const std::string& path, std::string_view content);
+
+    ChangelogIndex(ChangelogIndex&&) = default;
+    ChangelogIndex& operator=(ChangelogIndex&&) = default;
+
+    bool valid() const { return valid_; }
+
+    // Whether `oid` is recorded; false for an invalid index.
+    bool Contains(const git_oid& oid) const;
+
+    std::size_t size() const { return oid_count_; }
+    git_oid oid(std::size_t i) const;
+
+    // Offsets of the section header lines in the changelog, in file order.
+    const std::vector<std::size_t>& header_offsets() const { return header_offsets_; }
+
+    const std::optional<SemanticVersion>& last_version() const { return last_version_; }
+
+    // Checksum of the markdown the index matches.
+    std::uint64_t checksum() const { return checksum_; }
+
+    // The HEAD whose whole history went into the changelog; zero when the
+    // run that wrote it walked less than that.
+    const git_oid& head() const { return head_; }
+
+    // Writes the sidecar of a changelog made of `parts`, whose concatenation
+    // has the Checksum `checksum`. `oids` need not be sorted or unique.
+    // Failures are logged and otherwise ignored: without a sidecar the next
+    // run just parses the markdown.
+    static void Write(const std::string& path,
+                      const std::vector<std::string_view>& parts, std::uint64_t checksum,
+                      std::vector<git_oid> oids,
+                      const std::vector<std::size_t>& header_offsets,
+                      const std::optional<SemanticVersion>& last_version,
+                      const git_oid& head);
+
+   private:
+    struct Header;
+
+    MappedFile file_;
+    bool valid_ = false;
+    const unsigned char* oids_ = nullptr;
+    std::size_t oid_count_ = 0;
+    std::vector<std::size_t> header_offsets_;
+    std::optional<SemanticVersion> last_version_;
+    git_oid head_ = {};
+    std::uint64_t checksum_ = 0;
+};
+
+#endif  // CHANGELOG_CHANGELOG_INDEX_H_
@@ -0,0 +1,67 @@
+#ifndef CHANGELOG_COMMIT_CACHE_H_
+#define CHANGELOG_COMMIT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <git2.h>
+
+#include "changelog.h"
+#include "utils.h"
+
+// Persistent table of per-commit classification results, keyed by commit OID.
+//
+// The file is a fixed header followed by a sorted array of fixed-size records,
+// one bitmap of followed-path touches per record, and a blob holding summaries
+// and author names. It is mmap'd on open and binary-searched, so a warm run
+// resolves a commit without loading it from the object database.
+//
+// The cache is only valid for the followed-path set and prefix table it was
+// built with; a file written for a different key is ignored and replaced.
+class CommitCache {
+   public:
+    CommitCache(std::string path, const std::vector<std::string>& follow);
+    ~CommitCache();
+
+    CommitCache(const CommitCache&) = delete;
+    CommitCache& operator=(const CommitCache&) = delete;
+
+    // Fills `out` and returns true when `oid` is cached. A damaged record
+    // reads as a miss.
+    bool Lookup(const git_oid& oid, CommitInfo* out) const;
+
+    // Records a freshly classified commit; written out by Save().
+    void Insert(const git_oid& oid, const CommitInfo& info);
+
+    // Writes the merged table if anything was inserted. Failures are logged
+    // and otherwise ignored since the cache is only an optimization; the
+    // inserted rows are kept, without duplicates, for the next attempt.
+    void Save();
+
+   private:
+    struct Header;
+    struct Record;
+
+    void Map();
+    void Unmap();
+    bool ValidRecord(const Record& r) const;
+    std::vector<bool> MappedTouches(std::size_t index) const;
+
+    std::string path_;
+    std::uint64_t key_;
+    std::uint32_t path_count_;
+
+    // Read-only view of the file on disk.
+    MappedFile file_;
+    const Record* records_ = nullptr;
+    std::size_t record_count_ = 0;
+    const std::uint64_t* touch_words_ = nullptr;
+    const char* strings_ = nullptr;
+    std::size_t strings_size_ = 0;
+
+    std::vector<std::pair<git_oid, CommitInfo>> pending_;
+};
+
+#endif  // CHANGELOG_COMMIT_CACHE_H_
@@ -0,0 +1,77 @@
+#ifndef CHANGELOG_COMMIT_GRAPH_H_
+#define CHANGELOG_COMMIT_GRAPH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <git2.h>
+
+// Read-only view of the commit-graph that `git commit-graph write` leaves in
+// objects/info/commit-graph, or of the split chain in objects/info/commit-graphs.
+//
+// Only the commit lookup and the changed-path Bloom filters written with
+// --changed-paths are decoded. Each filter holds every path a commit changed
+// relative to its first parent, leading directories included, so a miss proves
+// that the commit leaves a path alone without loading the commit or its trees.
+class CommitGraph {
+   public:
+    // Filter hashes of a path and of each of its leading directories.
+    struct PathKey {
+        std::vector<std::uint32_t> hashes;
+    };
+
+    // The changed-path filter of one commit. A default one can rule nothing
+    // out, which is also what git writes for commits with too many changes.
+    class Filter {
+       public:
+        // False only when the commit certainly did not change the key's path.
+        bool MayContain(const PathKey& key) const;
+
+       private:
+        friend class CommitGraph;
+
+        const unsigned char* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+    // Returns nullptr when `objects_dir` holds no readable commit-graph.
+    // Without `read_changed_paths` the Bloom filter chunks are left unread,
+    // as git does with commitGraph.readChangedPaths=false.
+    static std::unique_ptr<CommitGraph> Open(const std::string& objects_dir,
+                                             bool read_changed_paths = true);
+
+    ~CommitGraph();
+
+    CommitGraph(const CommitGraph&) = delete;
+    CommitGraph& operator=(const CommitGraph&) = delete;
+
+    bool has_bloom_filters() const { return num_hashes_ > 0; }
+
+    // Key of the literal path `path`. Returns nothing without filters, or when
+    // the path is not in the normalized form git stores in them.
+    std::optional<PathKey> MakeKey(const std::string& path) const;
+
+    // The filter of `oid`; the default one if the commit is not in the graph.
+    Filter FilterFor(const git_oid& oid) const;
+
+   private:
+    struct Layer;
+
+    CommitGraph();
+
+    // Loads one graph file as the next layer on top of those already loaded.
+    bool AddLayer(const std::string& path);
+
+    std::vector<Layer> layers_;
+    bool read_changed_paths_ = true;
+    // Bloom settings shared by every layer with filters; layers written with
+    // other settings are treated as having none.
+    std::uint32_t hash_version_ = 0;
+    std::uint32_t num_hashes_ = 0;
+};
+
+#endif  // CHANGELOG_COMMIT_GRAPH_H_
@@ -0,0 +1,66 @@
+#ifndef CHANGELOG_COMMIT_TYPE_H_
+#define CHANGELOG_COMMIT_TYPE_H_
+
+#include <bitset>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+
+enum class CommitType {
+    kAdd,
+    kFeat,
+    kRefactor,
+    kRevert,
+    kDeprecated,
+    kFix,
+    kDocs,
+    kTest,
+    kPerf,
+};
+
+struct CommitTypeSpec {
+    CommitType type;
+    // Lowercase conventional-commit prefix, as in "feat: ...".
+    std::string_view prefix;
+    // Heading of the type's block in the changelog.
+    std::string_view name;
+};
+
+// Single source of truth for commit types, in enum order. Everything keyed by
+// type is a dense array indexed by the enum value, and the prefix matcher is
+// derived from this table.
+inline constexpr CommitTypeSpec kCommitTypeSpecs[] = {
+    {CommitType::kAdd, "add", "Add"},
+    {CommitType::kFeat, "feat", "Feat"},
+    {CommitType::kRefactor, "refactor", "Refactor"},
+    {CommitType::kRevert, "revert", "Revert"},
+    {CommitType::kDeprecated, "deprecated", "Deprecated"},
+    {CommitType::kFix, "fix", "Fix"},
+    {CommitType::kDocs, "docs", "Docs"},
+    {CommitType::kTest, "test", "Test"},
+    {CommitType::kPerf, "perf", "Perf"},
+};
+
+inline constexpr std::size_t kCommitTypeCount = std::size(kCommitTypeSpecs);
+
+constexpr std::size_t CommitTypeIndex(CommitType type) {
+    return static_cast<std::size_t>(type);
+}
+
+constexpr bool CommitTypeSpecsInEnumOrder() {
+    for (std::size_t i = 0; i < kCommitTypeCount; ++i) {
+        if (CommitTypeIndex(kCommitTypeSpecs[i].type) != i) return false;
+    }
+    return true;
+}
+static_assert(CommitTypeSpecsInEnumOrder(),
+              "kCommitTypeSpecs must list every CommitType in enum order");
+
+constexpr std::string_view CommitTypeName(CommitType type) {
+    return kCommitTypeSpecs[CommitTypeIndex(type)].name;
+}
+
+// Set of commit types, one bit per CommitTypeIndex().
+using CommitTypeSet = std::bitset<kCommitTypeCount>;
+
+#endif  // CHANGELOG_COMMIT_TYPE_H_
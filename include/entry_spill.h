@@ -0,0 +1,91 @@
+#ifndef CHANGELOG_ENTRY_SPILL_H_
+#define CHANGELOG_ENTRY_SPILL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <git2.h>
+
+#include "changelog.h"
+#include "commit_type.h"
+
+// The entries of a walk's sections, kept in a bounded amount of memory.
+//
+// Added entries are buffered as compact records. Whenever the buffer reaches
+// its share of the limit it is sorted and appended as one run to an unlinked
+// temporary file, in TMPDIR or /tmp. Finish() k-way merges the runs of each
+// section's type into one, in several passes when there are too many runs to
+// merge within the limit at once. ForEach() then only reads that run through
+// a small buffer, so the whole history never has to be in memory at once.
+class EntrySpill {
+   public:
+    // Keeps the buffered records within `memory_limit` bytes.
+    explicit EntrySpill(std::size_t memory_limit);
+    ~EntrySpill();
+
+    EntrySpill(const EntrySpill&) = delete;
+    EntrySpill& operator=(const EntrySpill&) = delete;
+
+    // Records an entry of section `section`. Not thread-safe.
+    void Add(std::size_t section, CommitType type, std::string_view summary,
+             const git_oid& oid, std::string_view author_name);
+
+    // Sorts what is still buffered, or spills it and merges the runs if
+    // anything was spilled before. Must be called once, after the last Add()
+    // and before the first ForEach().
+    void Finish();
+
+    // Calls `fn` for every entry of `type` in `section`, in CommitEntry
+    // order. The entry's strings are only valid during the call. May be
+    // called from several threads at once.
+    void ForEach(std::size_t section, CommitType type,
+                 const std::function<void(const CommitEntry&)>& fn) const;
+
+    // Number of sorted runs spilled so far, not counting merged ones.
+    std::size_t runs() const { return runs_; }
+
+   private:
+    struct Record;
+    class RunReader;
+
+    // Where one run keeps the entries of one section's type in the file.
+    struct Extent {
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+    };
+
+    std::size_t BufferedBytes() const;
+
+    // Sorts the buffer into (section, type, summary, OID) order.
+    void SortBuffer();
+
+    // Sorts the buffer, appends it to the file as a run and empties it.
+    void Spill();
+
+    // Appends `out` to the file and empties it.
+    void Write(std::string* out);
+
+    // Merges `count` extents into one appended to the file.
+    Extent Merge(const Extent* extents, std::size_t count);
+
+    const std::size_t memory_limit_;
+
+    std::vector<Record> records_;
+    // Summary and author name of each buffered record, back to back.
+    std::string text_;
+    bool finished_ = false;
+
+    // The unlinked temporary file, opened on the first spill.
+    int fd_ = -1;
+    std::uint64_t file_size_ = 0;
+    std::size_t runs_ = 0;
+    // Extents of every run, by section * kCommitTypeCount + type; a single
+    // merged one each after Finish().
+    std::vector<std::vector<Extent>> extents_;
+};
+
+#endif  // CHANGELOG_ENTRY_SPILL_H_
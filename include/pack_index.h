@@ -0,0 +1,57 @@
+#ifndef CHANGELOG_PACK_INDEX_H_
+#define CHANGELOG_PACK_INDEX_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <git2.h>
+
+#include "utils.h"
+
+// Read-only view of the version 2 .idx files in objects/pack, used to find
+// where in which packfile an object is stored without asking libgit2, whose
+// public API doesn't expose offsets.
+class PackIndex {
+   public:
+    // Where an object starts: the pack, numbered in file name order, and the
+    // byte offset in it.
+    struct Location {
+        std::uint32_t pack;
+        std::uint64_t offset;
+
+        bool operator<(const Location& o) const {
+            return pack != o.pack ? pack < o.pack : offset < o.offset;
+        }
+    };
+
+    // Maps every readable index in `pack_dir`; unreadable ones are skipped.
+    explicit PackIndex(const std::string& pack_dir);
+
+    PackIndex(const PackIndex&) = delete;
+    PackIndex& operator=(const PackIndex&) = delete;
+
+    // Returns nothing for objects that are loose or in no indexed pack.
+    std::optional<Location> Find(const git_oid& oid) const;
+
+   private:
+    struct Index {
+        MappedFile file;
+        // 256 cumulative object counts by first OID byte, the sorted OIDs,
+        // and the matching 32-bit and 64-bit offset tables.
+        const unsigned char* fanout = nullptr;
+        const unsigned char* oids = nullptr;
+        const unsigned char* offsets = nullptr;
+        const unsigned char* large_offsets = nullptr;
+        std::uint32_t count = 0;
+        std::uint32_t large_count = 0;
+    };
+
+    // Maps one index file; false if it is not a version 2 index.
+    bool Add(const std::string& path);
+
+    std::vector<Index> indexes_;
+};
+
+#endif  // CHANGELOG_PACK_INDEX_H_
@@ -0,0 +1,55 @@
+#ifndef CHANGELOG_PATH_TRIE_H_
+#define CHANGELOG_PATH_TRIE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <git2.h>
+
+// The literal paths among a walk's followed paths, compiled into a trie over
+// their components.
+//
+// Trees are content-addressed, so a path is unchanged exactly when its first
+// component is the same object with the same mode on both sides, or when the
+// subtree under it is and so on down. Match() therefore descends a commit's
+// tree and its parent's together once for all paths, and never enters a
+// subtree whose entry is unchanged, instead of looking every path up from the
+// root on its own.
+class PathTrie {
+   public:
+    PathTrie() = default;
+
+    // Compiles those of `paths` that IsLiteral() accepts.
+    explicit PathTrie(const std::vector<std::string>& paths);
+
+    // True when `path` names a single file or directory rather than a
+    // pattern, so it can be resolved with plain tree lookups. Anything that
+    // libgit2 would treat as a pathspec pattern is left to the diff machinery.
+    static bool IsLiteral(const std::string& path);
+
+    // Whether paths[i] of the constructor was compiled.
+    bool Covers(std::size_t i) const { return i < covered_.size() && covered_[i]; }
+
+    // Sets touches[i] for each compiled path that differs between the trees.
+    // Either tree may be null, as for the parent of a root commit.
+    void Match(git_repository* repo, git_tree* parent_tree, git_tree* commit_tree,
+               std::vector<bool>* touches) const;
+
+   private:
+    struct Node {
+        // Children by component name, as indexes into nodes_.
+        std::vector<std::pair<std::string, std::size_t>> children;
+        // Followed paths ending at this node.
+        std::vector<std::size_t> paths;
+    };
+
+    void MatchNode(git_repository* repo, const Node& node, const git_tree* parent_tree,
+                   const git_tree* commit_tree, std::vector<bool>* touches) const;
+
+    // nodes_[0] is the root, which no path ends at.
+    std::vector<Node> nodes_ = std::vector<Node>(1);
+    std::vector<bool> covered_;
+};
+
+#endif  // CHANGELOG_PATH_TRIE_H_
@@ -0,0 +1,142 @@
+#ifndef CHANGELOG_STATS_H_
+#define CHANGELOG_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class Counter {
+    kCommitsVisited,
+    kCommitsLookedUp,
+    kCacheHits,
+    kBloomRejected,
+    kBloomNegatives,
+    kPathChecks,
+    kDiffsComputed,
+    kEntriesFiltered,
+    kPeakEntries,
+    kTagsScanned,
+    kBytesRead,
+    kBytesWritten,
+    kRunsSpilled,
+};
+
+// Names used in the summary table and the trace, in enum order.
+inline constexpr std::string_view kCounterNames[] = {
+    "commits_visited", "commits_looked_up", "cache_hits",     "bloom_rejected",
+    "bloom_negatives", "path_checks",       "diffs_computed", "entries_filtered",
+    "peak_entries",    "tags_scanned",      "bytes_read",     "bytes_written",
+    "runs_spilled",
+};
+
+inline constexpr std::size_t kCounterCount = std::size(kCounterNames);
+
+// Spans kept for the trace by default once KeepSpans() is called; the oldest
+// are dropped beyond it.
+inline constexpr std::size_t kMaxTraceSpans = std::size_t{1} << 16;
+
+// Timings and counters of one run. Counters and timers may be updated from
+// any thread; they are cheap enough to stay on whether or not anything is
+// reported at the end. Timers are summed per phase as they close, so the
+// stats stay the same size however long they are kept.
+class Stats {
+   public:
+    Stats();
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    // Also keeps the individual spans for WriteTraceJson(), at most the last
+    // `max_spans` of them. Off by default.
+    void KeepSpans(std::size_t max_spans = kMaxTraceSpans);
+
+    // Zeroes the counters and forgets all timings, restarting the clock. No
+    // timer may be open.
+    void Reset();
+
+    void Add(Counter counter, std::uint64_t n = 1) {
+        counters_[static_cast<std::size_t>(counter)].fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    // Raises `counter` to `value` if it is lower.
+    void Max(Counter counter, std::uint64_t value);
+
+    std::uint64_t Get(Counter counter) const {
+        return counters_[static_cast<std::size_t>(counter)].load(
+            std::memory_order_relaxed);
+    }
+
+    // Records the lifetime of the timer as one span of the phase `name`.
+    // Spans started while another is open on the same thread nest under it.
+    class Timer {
+       public:
+        Timer(Stats* stats, const char* name);
+        ~Timer();
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+       private:
+        Stats* stats_;
+        const char* name_;
+        const char* parent_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // `name` must be a string literal or otherwise outlive the stats.
+    Timer Time(const char* name) { return Timer(this, name); }
+
+    // Per-phase totals followed by the counters, as an aligned text table.
+    std::string Summary() const;
+
+    // Writes the kept spans and the final counters as Chrome trace-event
+    // JSON, loadable in chrome://tracing or Perfetto. Throws
+    // std::runtime_error on failure.
+    void WriteTraceJson(const std::string& path) const;
+
+   private:
+    struct Span {
+        const char* name;
+        // Innermost timer open around this one on the same thread, if any.
+        const char* parent;
+        std::int64_t start_us;
+        std::int64_t duration_us;
+        int thread;
+        int depth;
+    };
+
+    // The spans of one name, parent, depth and kind of thread, summed.
+    struct Phase {
+        std::string_view name;
+        std::string_view parent;
+        bool worker;
+        int depth;
+        std::int64_t first_start_us;
+        std::size_t calls = 0;
+        std::int64_t total_us = 0;
+    };
+
+    std::int64_t Micros(std::chrono::steady_clock::time_point t) const;
+    void Record(const Span& span);
+
+    std::chrono::steady_clock::time_point start_;
+    // Thread the stats were created on; spans from others count as workers.
+    int owner_thread_;
+    std::array<std::atomic<std::uint64_t>, kCounterCount> counters_ = {};
+
+    mutable std::mutex mu_;
+    std::vector<Phase> phases_;
+    // Ring of the last `max_spans_` spans; `next_span_` is the oldest once
+    // it is full.
+    std::size_t max_spans_ = 0;
+    std::size_t next_span_ = 0;
+    std::vector<Span> spans_;
+};
+
+#endif  // CHANGELOG_STATS_H_
@@ -1,9 +1,135 @@
 #ifndef CHANGELOG_UTILS_H_
 #define CHANGELOG_UTILS_H_
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 std::vector<std::string> split(const std::string& str, const std::string& sep);
 
+// Decode the big-endian integers of git's binary file formats.
+inline std::uint32_t ReadBigEndian32(const unsigned char* p) {
+    return std::uint32_t{p[0]} << 24 | std::uint32_t{p[1]} << 16 |
+           std::uint32_t{p[2]} << 8 | std::uint32_t{p[3]};
+}
+
+inline std::uint64_t ReadBigEndian64(const unsigned char* p) {
+    return std::uint64_t{ReadBigEndian32(p)} << 32 | ReadBigEndian32(p + 4);
+}
+
+// 64-bit checksum of a byte stream fed in pieces of any size, consumed eight
+// bytes at a time. It only has to notice edits, not resist crafted ones.
+class Checksum {
+   public:
+    void Add(std::string_view data);
+    std::uint64_t Finish();
+
+   private:
+    void Mix(std::uint64_t word);
+    void Flush();
+
+    std::uint64_t hash_ = 0;
+    std::uint64_t size_ = 0;
+    char pending_[sizeof(std::uint64_t)] = {};
+    std::size_t pending_size_ = 0;
+};
+
+// Read-only memory mapping of a whole file. A missing or empty file maps to
+// an empty view.
+class MappedFile {
+   public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& o) noexcept;
+    MappedFile& operator=(MappedFile&& o) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view data() const {
+        return {static_cast<const char*>(addr_), size_};
+    }
+
+   private:
+    void* addr_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Append-only string storage for data that lives as long as one run. Views
+// returned by Store() and Intern() stay valid until the arena is destroyed,
+// since blocks are never moved or freed early.
+class StringArena {
+   public:
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    std::string_view Store(std::string_view str);
+
+    // Like Store(), but equal strings share a single copy.
+    std::string_view Intern(std::string_view str);
+
+   private:
+    static constexpr std::size_t kBlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cur_ = nullptr;
+    std::size_t left_ = 0;
+    std::unordered_set<std::string_view> interned_;
+};
+
+// Builds the new contents of `path` in a temporary file next to it, which
+// Commit() renames over `path`, so readers see either the old or the new
+// contents. A symlink is followed, and its target replaced instead. The rename
+// is synced to the directory before Commit() returns. The mode of an existing
+// file is kept, but not its owner and group: the new file belongs to the
+// writing user. A writer destroyed before Commit() removes the temporary file.
+// Throws std::runtime_error on failure.
+class AtomicFileWriter {
+   public:
+    explicit AtomicFileWriter(const std::string& path);
+    ~AtomicFileWriter();
+
+    AtomicFileWriter(const AtomicFileWriter&) = delete;
+    AtomicFileWriter& operator=(const AtomicFileWriter&) = delete;
+
+    // Appends the concatenation of `parts`.
+    void Append(const std::vector<std::string_view>& parts);
+
+    void Commit();
+
+   private:
+    std::string path_;
+    std::string tmp_path_;
+    int fd_ = -1;
+};
+
+// Writes the concatenation of `parts` to `path` with an AtomicFileWriter.
+void WriteFileAtomic(const std::string& path, const std::vector<std::string_view>& parts);
+
+// Waits for entries of a set of directories to change. Uses inotify on Linux
+// and degrades to plain timeouts elsewhere, or for directories that can't be
+// watched.
+class DirectoryWatcher {
+   public:
+    explicit DirectoryWatcher(const std::vector<std::string>& dirs);
+    ~DirectoryWatcher();
+
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Blocks until something in the directories changes, `timeout` passes or
+    // a signal arrives. Returns true when a change was seen.
+    bool Wait(std::chrono::milliseconds timeout);
+
+   private:
+    int fd_ = -1;
+};
+
 #endif  // CHANGELOG_UTILS_H_
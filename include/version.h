@@ -1,10 +1,11 @@
 #ifndef CHANGELOG_VERSION_H_
 #define CHANGELOG_VERSION_H_
 
-#include <set>
+#include <optional>
 #include <string>
+#include <string_view>
 
-enum class CommitType;
+#include "commit_type.h"
 
 struct SemanticVersion {
     int major = 0;
@@ -12,7 +13,10 @@ struct SemanticVersion {
     int patch = 0;
 
     std::string ToString() const;
-    static SemanticVersion Parse(const std::string& str);
+    // Parses "[v]MAJOR.MINOR.PATCH"; throws std::runtime_error otherwise.
+    static SemanticVersion Parse(std::string_view str);
+    // Like Parse(), but returns std::nullopt for anything that isn't a version.
+    static std::optional<SemanticVersion> TryParse(std::string_view str);
 
     bool operator==(const SemanticVersion& o) const;
     bool operator<(const SemanticVersion& o) const;
@@ -26,7 +30,7 @@ struct SemanticVersion {
 // - Each distinct PATCH type (fix, perf, refactor): +1 PATCH
 // - docs, test, deprecated: no bump
 SemanticVersion ComputeNextVersion(const SemanticVersion& base,
-                                   const std::set<CommitType>& types,
+                                   const CommitTypeSet& types,
                                    bool has_breaking_change);
 
 #endif  // CHANGELOG_VERSION_H_
@@ -1,16 +1,33 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
-#include <fstream>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <map>
 #include <memory>
-#include <regex>
-#include <sstream>
+#include <mutex>
+#include <queue>
 #include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 
 #include <git2.h>
 #include <spdlog/spdlog.h>
 
+#include "bounded_queue.h"
 #include "changelog.h"
+#include "changelog_index.h"
+#include "commit_cache.h"
+#include "entry_spill.h"
+#include "pack_index.h"
 #include "utils.h"
 #include "version.h"
 
@@ -24,8 +41,12 @@ struct GitRevwalkDeleter {
     void operator()(git_revwalk* w) const { git_revwalk_free(w); }
 };
 
-struct GitCommitDeleter {
-    void operator()(git_commit* c) const { git_commit_free(c); }
+struct GitOdbDeleter {
+    void operator()(git_odb* o) const { git_odb_free(o); }
+};
+
+struct GitOdbObjectDeleter {
+    void operator()(git_odb_object* o) const { git_odb_object_free(o); }
 };
 
 struct GitDiffDeleter {
@@ -36,17 +57,46 @@ struct GitTreeDeleter {
     void operator()(git_tree* t) const { git_tree_free(t); }
 };
 
+struct GitTreeEntryDeleter {
+    void operator()(git_tree_entry* e) const { git_tree_entry_free(e); }
+};
+
 struct GitRemoteDeleter {
     void operator()(git_remote* r) const { git_remote_free(r); }
 };
 
-using UniqueCommit = std::unique_ptr<git_commit, GitCommitDeleter>;
+struct GitObjectDeleter {
+    void operator()(git_object* o) const { git_object_free(o); }
+};
+
+struct GitReferenceDeleter {
+    void operator()(git_reference* r) const { git_reference_free(r); }
+};
+
+struct GitConfigDeleter {
+    void operator()(git_config* c) const { git_config_free(c); }
+};
+
+using UniqueOdb = std::unique_ptr<git_odb, GitOdbDeleter>;
+using UniqueOdbObject = std::unique_ptr<git_odb_object, GitOdbObjectDeleter>;
 using UniqueDiff = std::unique_ptr<git_diff, GitDiffDeleter>;
 using UniqueTree = std::unique_ptr<git_tree, GitTreeDeleter>;
+using UniqueTreeEntry = std::unique_ptr<git_tree_entry, GitTreeEntryDeleter>;
 using UniqueRemote = std::unique_ptr<git_remote, GitRemoteDeleter>;
+using UniqueObject = std::unique_ptr<git_object, GitObjectDeleter>;
+using UniqueReference = std::unique_ptr<git_reference, GitReferenceDeleter>;
+using UniqueConfig = std::unique_ptr<git_config, GitConfigDeleter>;
 
 struct LibGit2Init {
-    LibGit2Init() { git_libgit2_init(); }
+    LibGit2Init() {
+        git_libgit2_init();
+        // Partial clones made by older git carry extensions.partialClone,
+        // which libgit2 refuses unless told otherwise. Only commits and trees
+        // are ever read, and a blobless clone has all of those, so its
+        // promisor remote is never needed.
+        const char* extensions[] = {"partialclone"};
+        git_libgit2_opts(GIT_OPT_SET_EXTENSIONS, extensions, std::size(extensions));
+    }
     ~LibGit2Init() { git_libgit2_shutdown(); }
 };
 
@@ -59,54 +109,613 @@ static LibGit2Init g_libgit2_init;
                                  (e ? e->message : "unknown error")); \
     }
 
-}  // namespace
+// Looks up `path` in `tree`. Returns an empty entry when the tree is null or
+// does not contain the path.
+UniqueTreeEntry LookupTreeEntry(git_tree* tree, const std::string& path) {
+    if (!tree) return nullptr;
+    git_tree_entry* entry_raw = nullptr;
+    int e = git_tree_entry_bypath(&entry_raw, tree, path.c_str());
+    if (e == GIT_ENOTFOUND) return nullptr;
+    _CHECK_GIT2(e, "Failed to look up tree entry " + path);
+    return UniqueTreeEntry(entry_raw);
+}
 
-const std::map<CommitType, std::string>& CommitTypeNames() {
-    static const std::map<CommitType, std::string> names = {
-        {CommitType::kAdd, "Add"},
-        {CommitType::kFeat, "Feat"},
-        {CommitType::kRefactor, "Refactor"},
-        {CommitType::kRevert, "Revert"},
-        {CommitType::kDeprecated, "Deprecated"},
-        {CommitType::kFix, "Fix"},
-        {CommitType::kDocs, "Docs"},
-        {CommitType::kTest, "Test"},
-        {CommitType::kPerf, "Perf"},
+// Character classes of the ECMAScript regex grammar the changelog format was
+// originally specified with.
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+bool IsHex(char c) { return IsDigit(c) || (c >= 'a' && c <= 'f'); }
+bool IsWord(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
 
+bool StartsWith(std::string_view str, std::string_view prefix) {
+    return str.substr(0, prefix.size()) == prefix;
+}
+
+bool IsHexRun(std::string_view str) {
+    return !str.empty() && std::all_of(str.begin(), str.end(), IsHex);
+}
+
+constexpr char AsciiLower(char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; }
+
+constexpr std::size_t kMaxPrefixSize = [] {
+    std::size_t size = 0;
+    for (const auto& spec : kCommitTypeSpecs) {
+        size = std::max(size, spec.prefix.size());
+    }
+    return size;
+}();
+
+// kCommitTypeSpecs bucketed by prefix length and first letter, so a lookup
+// compares against at most a couple of rows. Rows sharing a bucket are
+// chained through `next`.
+struct PrefixIndex {
+    std::array<std::array<std::int8_t, 26>, kMaxPrefixSize + 1> head{};
+    std::array<std::int8_t, kCommitTypeCount> next{};
+};
+
+constexpr PrefixIndex BuildPrefixIndex() {
+    PrefixIndex index{};
+    for (auto& by_letter : index.head) {
+        for (auto& head : by_letter) head = -1;
+    }
+    for (std::size_t i = kCommitTypeCount; i-- > 0;) {
+        std::string_view prefix = kCommitTypeSpecs[i].prefix;
+        if (prefix.empty() || prefix[0] < 'a' || prefix[0] > 'z') {
+            throw "commit type prefixes must start with a lowercase letter";
+        }
+        std::int8_t& head = index.head[prefix.size()][prefix[0] - 'a'];
+        index.next[i] = head;
+        head = static_cast<std::int8_t>(i);
+    }
+    return index;
+}
+
+constexpr PrefixIndex kPrefixIndex = BuildPrefixIndex();
+
+// Case-insensitive exact match of `word` against the type prefixes.
+std::optional<CommitType> MatchCommitPrefix(std::string_view word) {
+    if (word.empty() || word.size() > kMaxPrefixSize) return std::nullopt;
+    char first = AsciiLower(word[0]);
+    if (first < 'a' || first > 'z') return std::nullopt;
+
+    for (int i = kPrefixIndex.head[word.size()][first - 'a']; i >= 0;
+         i = kPrefixIndex.next[i]) {
+        std::string_view prefix = kCommitTypeSpecs[i].prefix;
+        std::size_t k = 1;
+        while (k < word.size() && AsciiLower(word[k]) == prefix[k]) ++k;
+        if (k == word.size()) return kCommitTypeSpecs[i].type;
+    }
+    return std::nullopt;
+}
+
+struct SectionHeaderView {
+    std::string_view name;
+    std::string_view version;
+    std::string_view date;
+};
+
+// Parses the text after "## " in "name[@vX.Y.Z] (--|—) YYYY-MM-DD". The line
+// is anchored at the date, so it is taken apart from the right; the name is
+// everything left over, minus trailing whitespace.
+bool ParseSectionHeader(std::string_view rest, SectionHeaderView* out) {
+    constexpr std::size_t kDateSize = 10;
+    if (rest.size() < kDateSize) return false;
+    std::size_t date_pos = rest.size() - kDateSize;
+    std::string_view date = rest.substr(date_pos);
+    for (std::size_t i = 0; i < kDateSize; ++i) {
+        if ((i == 4 || i == 7) ? date[i] != '-' : !IsDigit(date[i])) return false;
+    }
+
+    std::size_t sep_end = date_pos;
+    while (sep_end > 0 && IsSpace(rest[sep_end - 1])) --sep_end;
+    if (sep_end == date_pos) return false;
+
+    std::size_t sep_pos;
+    std::string_view head = rest.substr(0, sep_end);
+    if (head.size() >= 2 && head.substr(head.size() - 2) == "--") {
+        sep_pos = sep_end - 2;
+    } else if (head.size() >= 3 && head.substr(head.size() - 3) == "—") {
+        sep_pos = sep_end - 3;
+    } else {
+        return false;
+    }
+
+    std::size_t name_end = sep_pos;
+    while (name_end > 0 && IsSpace(rest[name_end - 1])) --name_end;
+    if (name_end == sep_pos) return false;
+
+    std::string_view name = rest.substr(0, name_end);
+    std::string_view version;
+    if (name.empty()) {
+        // The name still needs a character, which it takes from the
+        // whitespace as long as at least one is left before the separator.
+        if (sep_pos - name_end < 2) return false;
+        name = rest.substr(0, 1);
+    } else {
+        // Split off a trailing "@vX.Y.Z", scanning the three numbers backwards.
+        std::size_t i = name.size();
+        bool is_version = true;
+        for (int part = 0; part < 3 && is_version; ++part) {
+            std::size_t digits_end = i;
+            while (i > 0 && IsDigit(name[i - 1])) --i;
+            is_version = i < digits_end && i > 0 && name[i - 1] == (part < 2 ? '.' : 'v');
+            if (is_version) --i;
+        }
+        if (is_version && i > 1 && name[i - 1] == '@') {
+            version = name.substr(i);
+            name = name.substr(0, i - 1);
+        }
+    }
+    if (name.find('\r') != std::string_view::npos) return false;
+
+    out->name = name;
+    out->version = version;
+    out->date = date;
+    return true;
+}
+
+// Fills the header fields of `out` from a "## " line, leaving its entries
+// alone.
+bool ParseHeaderLine(std::string_view line, ParsedSection* out) {
+    SectionHeaderView header;
+    if (!StartsWith(line, "## ") || !ParseSectionHeader(line.substr(3), &header)) {
+        return false;
+    }
+    out->header = line;
+    out->name = std::string(header.name);
+    out->version = std::nullopt;
+    if (!header.version.empty()) {
+        out->version = SemanticVersion::Parse(header.version);
+    }
+    out->date = std::string(header.date);
+    return true;
+}
+
+// The sections of `content` whose header lines start at `offsets`, without
+// their entries. Returns false unless every offset is such a line.
+bool ParseHeadersAt(std::string_view content, const std::vector<std::size_t>& offsets,
+                    std::vector<ParsedSection>* out) {
+    for (std::size_t offset : offsets) {
+        if (offset > content.size() || (offset > 0 && content[offset - 1] != '\n')) {
+            return false;
+        }
+        std::string_view line = content.substr(offset);
+        line = line.substr(0, line.find('\n'));
+        if (!ParseHeaderLine(line, &out->emplace_back())) return false;
+    }
+    return true;
+}
+
+// Appends the offsets of the section header lines of `content`.
+void FindSectionHeaders(std::string_view content, std::vector<std::size_t>* offsets) {
+    std::size_t pos = 0;
+    while (pos < content.size()) {
+        std::size_t eol = content.find('\n', pos);
+        if (eol == std::string_view::npos) eol = content.size();
+        ParsedSection section;
+        if (ParseHeaderLine(content.substr(pos, eol - pos), &section)) {
+            offsets->push_back(pos);
+        }
+        pos = eol + 1;
+    }
+}
+
+std::string IndexPath(const std::string& output) { return output + ".index"; }
+
+// Identifies the exact contents of a changelog, made of `parts`, to its
+// companions and its index.
+std::uint64_t MarkdownChecksum(const std::vector<std::string_view>& parts) {
+    Checksum checksum;
+    for (std::string_view part : parts) checksum.Add(part);
+    return checksum.Finish();
+}
+
+// Where the companion of `output` in another format goes, e.g.
+// CHANGELOG.jsonl next to CHANGELOG.md.
+std::string CompanionPath(const std::string& output, const char* extension) {
+    return std::filesystem::path(output).replace_extension(extension).string();
+}
+
+// Streamed output is handed to its file whenever this much is buffered.
+constexpr std::size_t kFlushSize = 64 * 1024;
+
+// Hands `out` over to `file`, if any, once it holds kFlushSize bytes. Returns
+// the number of bytes handed over.
+std::size_t FlushIfFull(fmt::memory_buffer* out, AtomicFileWriter* file) {
+    if (!file || out->size() < kFlushSize) return 0;
+    std::size_t size = out->size();
+    file->Append({{out->data(), size}});
+    out->clear();
+    return size;
+}
+
+// The binary companion starts with this magic, the format version, a
+// reserved word and, as a u64, the MarkdownChecksum() of the changelog it
+// matches. Then come the sections, newest first, each as
+//
+//   u32 name size, name, i32[3] version (-1s without one),
+//   u32 date size, date, u8 flags, u64 entry count,
+//
+// followed by its entries, each as
+//
+//   u8 CommitTypeIndex(), u8 flags, 20-byte OID,
+//   u32 summary size, summary, u32 author size, author.
+//
+// Integers are little-endian; flag bit 0 marks a breaking change.
+constexpr char kBinaryMagic[8] = {'C', 'L', 'G', 'E', 'N', 'T', 'R', 'Y'};
+constexpr std::uint32_t kBinaryFormatVersion = 2;
+constexpr std::uint8_t kBinaryFlagBreaking = 1 << 0;
+
+template <typename T>
+void AppendLittleEndian(fmt::memory_buffer* out, T value) {
+    auto bits = static_cast<std::make_unsigned_t<T>>(value);
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        out->push_back(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+}
+
+void AppendSizedString(fmt::memory_buffer* out, std::string_view str) {
+    AppendLittleEndian(out, static_cast<std::uint32_t>(str.size()));
+    out->append(str);
+}
+
+// Appends `str` as a quoted JSON string. Bytes from 0x80 up are passed
+// through, as commit messages are UTF-8.
+void AppendJsonString(fmt::memory_buffer* out, std::string_view str) {
+    out->push_back('"');
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                out->append(std::string_view("\\\""));
+                break;
+            case '\\':
+                out->append(std::string_view("\\\\"));
+                break;
+            case '\n':
+                out->append(std::string_view("\\n"));
+                break;
+            case '\r':
+                out->append(std::string_view("\\r"));
+                break;
+            case '\t':
+                out->append(std::string_view("\\t"));
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    fmt::format_to(std::back_inserter(*out), "\\u{:04x}",
+                                   static_cast<unsigned>(c));
+                } else {
+                    out->push_back(c);
+                }
+        }
+    }
+    out->push_back('"');
+}
+
+// Splits "name@vX.Y.Z" at its last '@'. Leaves `version` empty for a name
+// without one.
+void SplitSectionName(std::string_view section, std::string_view* name,
+                      std::string_view* version) {
+    std::size_t at = section.rfind('@');
+    *name = section.substr(0, at);
+    *version =
+        at == std::string_view::npos ? std::string_view() : section.substr(at + 1);
+}
+
+struct EntryView {
+    std::string_view summary;
+    std::string_view author_name;
+    std::string_view hash;
+};
+
+// Splits "<head>/commit/<hash>" at the last "/commit/". Returns the offset of
+// "/commit/" in `body`, or npos when the hash is not a run of hex digits.
+std::size_t SplitCommitLink(std::string_view body, std::string_view* hash) {
+    constexpr std::string_view kCommit = "/commit/";
+    std::size_t pos = body.rfind(kCommit);
+    if (pos == std::string_view::npos) return pos;
+    *hash = body.substr(pos + kCommit.size());
+    return IsHexRun(*hash) ? pos : std::string_view::npos;
+}
+
+// Length of the abbreviated hash shown in an entry's link, as git prints it.
+constexpr std::size_t kShortHashSize = 7;
+
+// Finds the rightmost "<open><hex>](" that ends before `limit`, leaving a
+// non-empty URL between it and `limit`.
+std::size_t FindShortHashLink(std::string_view body, std::string_view open,
+                              std::size_t limit) {
+    std::size_t pos = body.rfind(open, limit);
+    while (pos != std::string_view::npos) {
+        std::size_t hex_begin = pos + open.size();
+        std::size_t hex_end = hex_begin;
+        while (hex_end < body.size() && IsHex(body[hex_end])) ++hex_end;
+        if (hex_end > hex_begin && body.compare(hex_end, 2, "](") == 0 &&
+            hex_end + 2 < limit) {
+            return pos;
+        }
+        if (pos == 0) break;
+        pos = body.rfind(open, pos - 1);
+    }
+    return std::string_view::npos;
+}
+
+// "- summary by **author** in [#short](url/commit/full)"
+bool ParseEntry(std::string_view line, EntryView* out) {
+    if (line.size() < 3 || line.back() != ')' ||
+        line.find('\r') != std::string_view::npos) {
+        return false;
+    }
+    std::string_view body = line.substr(0, line.size() - 1);
+
+    std::size_t commit_pos = SplitCommitLink(body, &out->hash);
+    if (commit_pos == std::string_view::npos) return false;
+
+    constexpr std::string_view kIn = "** in [#";
+    std::size_t link_pos = FindShortHashLink(body, kIn, commit_pos);
+    if (link_pos == std::string_view::npos) return false;
+
+    // Summary and author are both non-empty, so " by **" starts at least one
+    // character past "- " and ends at least one before the link.
+    constexpr std::string_view kBy = " by **";
+    if (link_pos < 2 + 1 + kBy.size() + 1) return false;
+    std::size_t by_pos = body.rfind(kBy, link_pos - kBy.size() - 1);
+    if (by_pos == std::string_view::npos || by_pos < 3) return false;
+
+    out->summary = body.substr(2, by_pos - 2);
+    out->author_name = body.substr(by_pos + kBy.size(), link_pos - by_pos - kBy.size());
+    return true;
+}
+
+// "- summary ([#short](url/commit/full))", written by changelog@v0.1.0.
+bool ParseOldEntry(std::string_view line, EntryView* out) {
+    if (line.size() < 4 || line.substr(line.size() - 2) != "))" ||
+        line.find('\r') != std::string_view::npos) {
+        return false;
+    }
+    std::string_view body = line.substr(0, line.size() - 2);
+
+    std::size_t commit_pos = SplitCommitLink(body, &out->hash);
+    if (commit_pos == std::string_view::npos) return false;
+
+    std::size_t link_pos = FindShortHashLink(body, " ([#", commit_pos);
+    if (link_pos == std::string_view::npos || link_pos < 3) return false;
+
+    out->summary = body.substr(2, link_pos - 2);
+    out->author_name = {};
+    return true;
+}
+
+// The header lines and message of a commit object, as views into its raw
+// data.
+struct RawCommit {
+    std::string_view tree;
+    // Empty for root commits.
+    std::string_view first_parent;
+    // "Name <email> time offset".
+    std::string_view author;
+    std::string_view message;
+};
+
+// Splits a raw commit object into the parts GetGitLogs needs, scanning the
+// header lines with memchr and decoding none of them. Returns false when the
+// tree or author header is missing.
+bool ScanRawCommit(std::string_view data, RawCommit* out) {
+    std::size_t pos = 0;
+    while (pos < data.size()) {
+        const char* start = data.data() + pos;
+        const auto* nl =
+            static_cast<const char*>(std::memchr(start, '\n', data.size() - pos));
+        std::string_view line(start, nl ? nl - start : data.size() - pos);
+        pos += line.size() + 1;
+        // A blank line ends the headers.
+        if (line.empty()) break;
+
+        // Only the first of each header counts; continuation lines of
+        // multi-line headers such as gpgsig start with a space.
+        if (line.compare(0, 5, "tree ") == 0 && out->tree.empty()) {
+            out->tree = line.substr(5);
+        } else if (line.compare(0, 7, "parent ") == 0 && out->first_parent.empty()) {
+            out->first_parent = line.substr(7);
+        } else if (line.compare(0, 7, "author ") == 0 && out->author.empty()) {
+            out->author = line.substr(7);
+        }
+    }
+    out->message = pos < data.size() ? data.substr(pos) : std::string_view();
+    return !out->tree.empty() && !out->author.empty();
+}
+
+// Calls `fn` with the hex OID of each parent of the raw commit `data`.
+template <typename Fn>
+void ForEachParent(std::string_view data, Fn fn) {
+    // Parents are listed right after the tree, before any other header.
+    std::size_t pos = data.find('\n');
+    while (pos != std::string_view::npos && data.compare(pos + 1, 7, "parent ") == 0) {
+        std::size_t begin = pos + 8;
+        pos = data.find('\n', begin);
+        fn(data.substr(begin, pos == std::string_view::npos ? pos : pos - begin));
+    }
+}
+
+bool IsGitSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+// What git_commit_summary() returns for `message`: its first paragraph with
+// runs of whitespace that span a line break folded into one space, and the
+// trailing whitespace dropped. Most summaries are just the first line, which
+// is returned as a view into `message`; others are built in `storage`.
+std::string_view CommitSummary(std::string_view message, std::string* storage) {
+    std::size_t begin = message.find_first_not_of('\n');
+    if (begin == std::string_view::npos) return {};
+    message.remove_prefix(begin);
+
+    // libgit2 works on C strings, so a NUL ends the message there.
+    auto at = [&](std::size_t i) { return i < message.size() ? message[i] : '\0'; };
+    // Returns the end of the line starting at `i` if it is blank, or npos.
+    auto blank_line_end = [&](std::size_t i) {
+        while (at(i) != '\0' && at(i) != '\n' && IsGitSpace(at(i))) ++i;
+        return at(i) == '\0' || at(i) == '\n' ? i : std::string_view::npos;
     };
-    return names;
-}
-
-const std::map<std::string, CommitType>& PrefixToCommitType() {
-    static const std::map<std::string, CommitType> prefixes = {
-        {"add", CommitType::kAdd},
-        {"feat", CommitType::kFeat},
-        {"refactor", CommitType::kRefactor},
-        {"revert", CommitType::kRevert},
-        {"deprecated", CommitType::kDeprecated},
-        {"fix", CommitType::kFix},
-        {"docs", CommitType::kDocs},
-        {"test", CommitType::kTest},
-        {"perf", CommitType::kPerf},
-    };
-    return prefixes;
+
+    std::size_t line_end = std::min(message.find('\n'), message.find('\0'));
+    if (line_end == std::string_view::npos || at(line_end) == '\0' ||
+        blank_line_end(line_end + 1) != std::string_view::npos) {
+        std::string_view line = message.substr(0, line_end);
+        while (!line.empty() && IsGitSpace(line.back())) line.remove_suffix(1);
+        return line;
+    }
+
+    storage->clear();
+    std::size_t space = std::string_view::npos;
+    bool space_has_newline = false;
+    for (std::size_t i = 0; at(i) != '\0'; ++i) {
+        char c = message[i];
+        if (c == '\n' && blank_line_end(i + 1) != std::string_view::npos) break;
+        if (IsGitSpace(c)) {
+            if (space == std::string_view::npos) {
+                space = i;
+                space_has_newline = false;
+            }
+            space_has_newline |= c == '\n';
+            continue;
+        }
+        if (space != std::string_view::npos) {
+            if (space_has_newline) {
+                storage->push_back(' ');
+            } else {
+                storage->append(message.substr(space, i - space));
+            }
+            space = std::string_view::npos;
+        }
+        storage->push_back(c);
+    }
+    return *storage;
+}
+
+// The name part of a signature such as RawCommit::author, trimmed the way
+// libgit2 trims it.
+std::optional<std::string_view> SignatureName(std::string_view signature) {
+    std::size_t email_begin = signature.rfind('<');
+    std::size_t email_end = signature.rfind('>');
+    if (email_begin == std::string_view::npos || email_end == std::string_view::npos ||
+        email_end < email_begin) {
+        return std::nullopt;
+    }
+    std::string_view name = signature.substr(0, email_begin);
+    while (!name.empty() && IsGitSpace(name.front())) name.remove_prefix(1);
+    while (!name.empty() && IsGitSpace(name.back())) name.remove_suffix(1);
+    return name;
 }
 
+UniqueOdb OpenOdb(git_repository* repo) {
+    git_odb* odb_raw = nullptr;
+    _CHECK_GIT2(git_repository_odb(&odb_raw, repo), "Failed to open object database");
+    return UniqueOdb(odb_raw);
+}
+
+UniqueOdbObject ReadCommitObject(git_odb* odb, const git_oid& oid) {
+    git_odb_object* object_raw = nullptr;
+    _CHECK_GIT2(git_odb_read(&object_raw, odb, &oid), "Failed to read commit");
+    UniqueOdbObject object(object_raw);
+    if (git_odb_object_type(object.get()) != GIT_OBJECT_COMMIT) {
+        char hex[GIT_OID_SHA1_HEXSIZE + 1];
+        git_oid_tostr(hex, sizeof(hex), &oid);
+        throw std::runtime_error(std::string("Not a commit: ") + hex);
+    }
+    return object;
+}
+
+std::string_view ObjectData(git_odb_object* object) {
+    return {static_cast<const char*>(git_odb_object_data(object)),
+            git_odb_object_size(object)};
+}
+
+git_oid ParseHexOid(std::string_view hex) {
+    git_oid oid;
+    if (hex.size() != GIT_OID_SHA1_HEXSIZE ||
+        git_oid_fromstrn(&oid, hex.data(), hex.size()) < 0) {
+        throw std::runtime_error("Malformed object id " + std::string(hex));
+    }
+    return oid;
+}
+
+UniqueTree LookupTree(git_repository* repo, std::string_view hex) {
+    git_oid oid = ParseHexOid(hex);
+    git_tree* tree_raw = nullptr;
+    _CHECK_GIT2(git_tree_lookup(&tree_raw, repo, &oid), "Failed to get tree");
+    return UniqueTree(tree_raw);
+}
+
+// Loads the tree of `commit` and of its first parent. The parent tree is left
+// empty for root commits so diffs treat every path as added. The parent is
+// only scanned for its tree header, read through `odb`, the object database of
+// `repo`.
+void LoadCommitTrees(git_repository* repo, git_odb* odb, const RawCommit& commit,
+                     UniqueTree& commit_tree, UniqueTree& parent_tree) {
+    commit_tree = LookupTree(repo, commit.tree);
+    if (commit.first_parent.empty()) return;
+
+    git_oid parent_oid = ParseHexOid(commit.first_parent);
+    UniqueOdbObject parent_object = ReadCommitObject(odb, parent_oid);
+    RawCommit parent;
+    if (!ScanRawCommit(ObjectData(parent_object.get()), &parent)) {
+        throw std::runtime_error("Malformed commit " +
+                                 std::string(commit.first_parent));
+    }
+    parent_tree = LookupTree(repo, parent.tree);
+}
+
+// The commit-graph of `repo`, unless core.commitGraph turns it off as it
+// does for git itself.
+std::unique_ptr<CommitGraph> OpenCommitGraph(git_repository* repo) {
+    bool read_changed_paths = true;
+    git_config* config_raw = nullptr;
+    if (git_repository_config_snapshot(&config_raw, repo) == 0) {
+        UniqueConfig config(config_raw);
+        int enabled = 1;
+        if (git_config_get_bool(&enabled, config.get(), "core.commitGraph") == 0 &&
+            !enabled) {
+            return nullptr;
+        }
+        // Newer git spells readChangedPaths=false as changedPathsVersion=0.
+        std::int32_t version = -1;
+        if ((git_config_get_bool(&enabled, config.get(),
+                                 "commitGraph.readChangedPaths") == 0 &&
+             !enabled) ||
+            (git_config_get_int32(&version, config.get(),
+                                  "commitGraph.changedPathsVersion") == 0 &&
+             version == 0)) {
+            read_changed_paths = false;
+        }
+    }
+    return CommitGraph::Open(std::string(git_repository_commondir(repo)) + "objects",
+                             read_changed_paths);
+}
+
+}  // namespace
+
 Changelog::Changelog(Config config) : config_(std::move(config)) {
-    _CHECK_GIT2(git_repository_open(&repo_, config_.repo.c_str()),
-                "Failed to open repository at " + config_.repo);
+    if (config_.trace) stats_.KeepSpans();
+    auto timer = stats_.Time("open_repository");
+    repo_ = OpenRepository();
+    graph_ = OpenCommitGraph(repo_);
     if (config_.url.empty()) {
         git_remote* remote_raw = nullptr;
         int e = git_remote_lookup(&remote_raw, repo_, "origin");
         UniqueRemote remote(remote_raw);
+        // Thrown rather than exiting, as the library may be embedded; the
+        // destructor won't run, so the repository is released here.
         if (e == 0) {
             config_.url = std::string(git_remote_url(remote.get()));
-        } else if (e == GIT_ENOTFOUND) {
-            spdlog::error("Repository {} not found.", config_.repo);
-            std::exit(e);
-        } else if (e == GIT_EINVALIDSPEC) {
-            spdlog::error("ref/spec was not in valid format.");
-            std::exit(e);
+        } else if (e == GIT_ENOTFOUND || e == GIT_EINVALIDSPEC) {
+            git_repository_free(repo_);
+            repo_ = nullptr;
+            throw std::runtime_error(e == GIT_ENOTFOUND
+                                         ? "Repository " + config_.repo + " not found"
+                                         : "ref/spec was not in valid format");
         }
     }
     if (config_.url.compare(0, kSSHPrefix.length(), kSSHPrefix) == 0) {
@@ -117,6 +726,19 @@ Changelog::Changelog(Config config) : config_(std::move(config)) {
     config_.repo_name = comps[comps.size() - 1];
 }
 
+git_repository* Changelog::OpenRepository() const {
+    git_repository* repo = nullptr;
+    if (config_.bare) {
+        unsigned int flags = GIT_REPOSITORY_OPEN_BARE | GIT_REPOSITORY_OPEN_NO_SEARCH;
+        _CHECK_GIT2(git_repository_open_ext(&repo, config_.repo.c_str(), flags, nullptr),
+                    "Failed to open repository at " + config_.repo);
+        return repo;
+    }
+    _CHECK_GIT2(git_repository_open(&repo, config_.repo.c_str()),
+                "Failed to open repository at " + config_.repo);
+    return repo;
+}
+
 Changelog::~Changelog() {
     if (repo_) {
         git_repository_free(repo_);
@@ -131,12 +753,6 @@ std::string Changelog::SSH2HTTPS(const std::string url) {
     return https;
 }
 
-std::string Changelog::ShortHash(const git_oid* oid) {
-    char buf[8] = {};
-    git_oid_tostr(buf, sizeof(buf), oid);
-    return std::string(buf);
-}
-
 std::string Changelog::FullHash(const git_oid* oid) {
     char buf[GIT_OID_SHA1_HEXSIZE + 1] = {};
     git_oid_tostr(buf, sizeof(buf), oid);
@@ -152,268 +768,1197 @@ std::string Changelog::FormatDate(git_time_t time) {
     return std::string(buf);
 }
 
-bool Changelog::IsBreakingChange(const std::string& summary) {
-    auto colon_pos = summary.find(':');
-    if (colon_pos == std::string::npos || colon_pos == 0) {
-        return false;
+SummaryClass Changelog::ClassifySummary(std::string_view summary) {
+    // Find the colon ending the prefix, and the start of a "(scope)".
+    std::size_t paren_pos = std::string_view::npos;
+    std::size_t colon_pos = 0;
+    for (; colon_pos < summary.size() && summary[colon_pos] != ':'; ++colon_pos) {
+        if (summary[colon_pos] == '(' && paren_pos == std::string_view::npos) {
+            paren_pos = colon_pos;
+        }
     }
-    return summary[colon_pos - 1] == '!';
-}
+    if (colon_pos == summary.size()) return {};
 
-std::optional<CommitType> Changelog::CategorizeCommit(const std::string& summary) {
-    auto colon_pos = summary.find(':');
-    if (colon_pos == std::string::npos) {
-        return std::nullopt;
-    }
+    SummaryClass result;
+    result.breaking = colon_pos > 0 && summary[colon_pos - 1] == '!';
 
-    std::string prefix = summary.substr(0, colon_pos);
-    // Convert to lowercase for matching.
-    std::transform(prefix.begin(), prefix.end(), prefix.begin(), ::tolower);
     // Strip scope like "fix(core)" -> "fix"
-    auto paren_pos = prefix.find('(');
-    if (paren_pos != std::string::npos) {
-        prefix = prefix.substr(0, paren_pos);
-    }
+    std::string_view prefix = summary.substr(0, std::min(colon_pos, paren_pos));
     // Strip breaking-change marker: "feat!" -> "feat"
     if (!prefix.empty() && prefix.back() == '!') {
-        prefix.pop_back();
-    }
-
-    const auto& prefixes = PrefixToCommitType();
-    auto it = prefixes.find(prefix);
-    if (it != prefixes.end()) {
-        return it->second;
+        prefix.remove_suffix(1);
     }
-    return std::nullopt;
+    result.type = MatchCommitPrefix(prefix);
+    return result;
 }
 
-std::string Changelog::FormatEntry(const CommitEntry& entry) {
-    std::string short_hash = ShortHash(&entry.oid);
-    std::string full_hash = FullHash(&entry.oid);
-    return entry.summary + " by **" + entry.author_name + "** in [#" + short_hash +
-           "](" + config_.url + "/commit/" + full_hash + ")";
+bool Changelog::IsBreakingChange(std::string_view summary) {
+    return ClassifySummary(summary).breaking;
 }
 
-bool Changelog::CommitTouchesPath(git_commit* commit, const std::string& path) const {
-    git_tree* commit_tree_raw = nullptr;
-    _CHECK_GIT2(git_commit_tree(&commit_tree_raw, commit), "Failed to get tree");
-    UniqueTree commit_tree(commit_tree_raw);
+std::optional<CommitType> Changelog::CategorizeCommit(std::string_view summary) {
+    return ClassifySummary(summary).type;
+}
 
-    UniqueTree parent_tree;
-    if (git_commit_parentcount(commit) > 0) {
-        git_commit* parent_raw = nullptr;
-        _CHECK_GIT2(git_commit_parent(&parent_raw, commit, 0), "Failed to get parent");
-        UniqueCommit parent(parent_raw);
+void Changelog::FormatEntry(fmt::memory_buffer* out, const CommitEntry& entry) const {
+    // The short hash is a prefix of the full one, so the OID is hex-encoded
+    // once.
+    char hex[GIT_OID_SHA1_HEXSIZE];
+    git_oid_fmt(hex, &entry.oid);
+    std::string_view full_hash(hex, sizeof(hex));
+    std::string_view short_hash = full_hash.substr(0, kShortHashSize);
+    fmt::format_to(std::back_inserter(*out), "- {} by **{}** in [#{}]({}/commit/{})\n",
+                   entry.summary, entry.author_name, short_hash, config_.url,
+                   full_hash);
+}
 
-        git_tree* parent_tree_raw = nullptr;
-        _CHECK_GIT2(git_commit_tree(&parent_tree_raw, parent.get()),
-                    "Failed to get parent tree");
-        parent_tree.reset(parent_tree_raw);
+bool Changelog::CommitTouchesPath(git_repository* repo, git_tree* parent_tree,
+                                  git_tree* commit_tree, const std::string& path) const {
+    stats_.Add(Counter::kPathChecks);
+    if (PathTrie::IsLiteral(path)) {
+        // Git trees are content-addressed: the path is unchanged exactly when
+        // both sides resolve to the same object with the same mode.
+        std::string literal = path;
+        while (literal.back() == '/') literal.pop_back();
+
+        UniqueTreeEntry old_entry = LookupTreeEntry(parent_tree, literal);
+        UniqueTreeEntry new_entry = LookupTreeEntry(commit_tree, literal);
+        if (!old_entry || !new_entry) {
+            return old_entry != new_entry;
+        }
+        return !git_oid_equal(git_tree_entry_id(old_entry.get()),
+                              git_tree_entry_id(new_entry.get())) ||
+               git_tree_entry_filemode(old_entry.get()) !=
+                   git_tree_entry_filemode(new_entry.get());
     }
 
+    // Glob pathspecs can match across unrelated subtrees, so fall back to a
+    // full diff filtered by the pattern. Only whether anything matched is
+    // asked for, so entries are compared by OID and mode alone and no blob
+    // is ever loaded, which a blobless partial clone could not do anyway.
     git_diff_options opts = {};
     git_diff_options_init(&opts, GIT_DIFF_OPTIONS_VERSION);
+    opts.flags |= GIT_DIFF_SKIP_BINARY_CHECK;
     char* pathspec = const_cast<char*>(path.c_str());
     opts.pathspec.strings = &pathspec;
     opts.pathspec.count = 1;
 
     git_diff* diff_raw = nullptr;
-    _CHECK_GIT2(git_diff_tree_to_tree(&diff_raw, repo_, parent_tree.get(),
-                                      commit_tree.get(), &opts),
-                "Failed to diff trees");
+    _CHECK_GIT2(
+        git_diff_tree_to_tree(&diff_raw, repo, parent_tree, commit_tree, &opts),
+        "Failed to diff trees");
     UniqueDiff diff(diff_raw);
+    stats_.Add(Counter::kDiffsComputed);
 
     return git_diff_num_deltas(diff.get()) > 0;
 }
 
-SectionData Changelog::GetGitLogs(const std::string& follow_path) {
-    SectionData data;
+Changelog::FollowSet Changelog::MakeFollowSet(
+    const std::vector<std::string>& follow_paths) const {
+    FollowSet follow;
+    follow.paths = follow_paths;
+    follow.trie = PathTrie(follow_paths);
+    if (!graph_ || !graph_->has_bloom_filters()) return follow;
+    for (const std::string& path : follow_paths) {
+        follow.keys.push_back(PathTrie::IsLiteral(path) ? graph_->MakeKey(path)
+                                                         : std::nullopt);
+    }
+    return follow;
+}
+
+bool Changelog::RejectedByBloom(const git_oid& oid, const PathKeys& keys) const {
+    if (keys.empty()) return false;
+    CommitGraph::Filter filter = graph_->FilterFor(oid);
+    for (const auto& key : keys) {
+        if (!key || filter.MayContain(*key)) return false;
+    }
+    stats_.Add(Counter::kBloomRejected);
+    return true;
+}
+
+CommitInfo Changelog::ClassifyCommit(git_repository* repo, git_odb* odb,
+                                     const git_oid& oid,
+                                     const FollowSet& follow) const {
+    // The raw object is scanned instead of going through git_commit_lookup,
+    // which would parse every header and the whole message and keep the
+    // result in libgit2's object cache, only for most commits to carry no
+    // conventional prefix.
+    UniqueOdbObject object = ReadCommitObject(odb, oid);
+    stats_.Add(Counter::kCommitsLookedUp);
+    return ClassifyCommitData(repo, odb, oid, ObjectData(object.get()), follow);
+}
+
+CommitInfo Changelog::ClassifyCommitData(git_repository* repo, git_odb* odb,
+                                         const git_oid& oid, std::string_view data,
+                                         const FollowSet& follow) const {
+    CommitInfo info;
+
+    RawCommit commit;
+    if (!ScanRawCommit(data, &commit)) {
+        throw std::runtime_error("Malformed commit " + FullHash(&oid));
+    }
+
+    std::string summary_storage;
+    std::string_view summary = CommitSummary(commit.message, &summary_storage);
+    SummaryClass summary_class = ClassifySummary(summary);
+    info.breaking = summary_class.breaking;
+    info.type = summary_class.type;
+    // Such a commit can't affect any section, so skip the path checks.
+    if (!info.type && !info.breaking) return info;
+
+    std::optional<std::string_view> author_name = SignatureName(commit.author);
+    if (!author_name) {
+        throw std::runtime_error("Malformed author in commit " + FullHash(&oid));
+    }
+    info.summary = summary;
+    info.author_name = *author_name;
+
+    const std::vector<std::string>& paths = follow.paths;
+    if (!paths.empty()) {
+        // Paths whose filter bits are missing were certainly left alone; the
+        // trees are only loaded if some path is left to check.
+        std::vector<bool> check(paths.size(), true);
+        if (!follow.keys.empty()) {
+            CommitGraph::Filter filter = graph_->FilterFor(oid);
+            for (std::size_t i = 0; i < follow.keys.size(); ++i) {
+                const auto& key = follow.keys[i];
+                if (key && !filter.MayContain(*key)) {
+                    check[i] = false;
+                    stats_.Add(Counter::kBloomNegatives);
+                }
+            }
+        }
+
+        info.touches.resize(paths.size());
+        if (std::find(check.begin(), check.end(), true) != check.end()) {
+            UniqueTree commit_tree;
+            UniqueTree parent_tree;
+            LoadCommitTrees(repo, odb, commit, commit_tree, parent_tree);
+
+            // The literal paths are matched in one walk over both trees.
+            // Paths the filters ruled out may come out touched as well, which
+            // is harmless: a filter miss is certain, so they never are.
+            bool trie_checked = false;
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                if (!check[i] || !follow.trie.Covers(i)) continue;
+                if (!trie_checked) {
+                    follow.trie.Match(repo, parent_tree.get(), commit_tree.get(),
+                                      &info.touches);
+                    trie_checked = true;
+                }
+                stats_.Add(Counter::kPathChecks);
+            }
+            for (std::size_t i = 0; i < paths.size(); ++i) {
+                if (!check[i] || follow.trie.Covers(i)) continue;
+                info.touches[i] = CommitTouchesPath(repo, parent_tree.get(),
+                                                    commit_tree.get(), paths[i]);
+            }
+        }
+    }
+
+    return info;
+}
+
+std::vector<SectionData> Changelog::GetGitLogs(
+    const std::vector<std::string>& follow_paths, const OidSet& hidden,
+    CommitCache* cache, bool include_all, const std::vector<Release>& releases) {
+    // One section per followed path, plus one for the whole repository when
+    // asked for or when nothing is followed; one such group per release and
+    // one for unreleased commits.
+    include_all = include_all || follow_paths.empty();
+    std::size_t width = follow_paths.size() + include_all;
+    std::vector<SectionData> sections(width * (releases.size() + 1));
+    if (spill_) {
+        for (std::size_t i = 0; i < sections.size(); ++i) sections[i].spilled = i;
+    }
+
+    auto record = [&](const git_oid& oid, const CommitInfo& info, std::size_t release) {
+        std::size_t group = release * width;
+
+        std::optional<CommitEntry> entry;
+        if (info.type && !spill_) {
+            entry.emplace(CommitEntry{
+                .summary = arena_.Store(info.summary),
+                .oid = oid,
+                .author_name = arena_.Intern(info.author_name),
+            });
+        }
+
+        bool recorded = false;
+        for (std::size_t i = 0; i < width; ++i) {
+            if (i < follow_paths.size() && !info.touches[i]) continue;
+
+            SectionData& data = sections[group + i];
+            if (info.breaking) {
+                data.has_breaking_change = true;
+            }
+            if (entry) {
+                data.entries[*info.type].insert(*entry);
+                recorded = true;
+            } else if (info.type) {
+                spill_->Add(group + i, *info.type, info.summary, oid, info.author_name);
+                ++data.spilled_counts[CommitTypeIndex(*info.type)];
+                recorded = true;
+            }
+        }
+
+        if (recorded) {
+            spdlog::debug("{} -> {}", CommitTypeName(*info.type), info.summary);
+        }
+    };
+
+    WalkHistory(follow_paths, hidden, cache, !include_all, releases,
+                /*in_walk_order=*/false, record);
+    return sections;
+}
+
+void Changelog::StreamEntries(const std::vector<std::string>& follow,
+                              const EntryCallback& callback, bool include_all) {
+    include_all = include_all || follow.empty();
+    std::size_t width = follow.size() + include_all;
+    auto stream = [&](const git_oid& oid, const CommitInfo& info, std::size_t) {
+        if (!info.type) return;
+        StreamedEntry streamed = {
+            CommitEntry{info.summary, oid, info.author_name},
+            *info.type,
+            info.breaking,
+            0,
+        };
+        for (std::size_t i = 0; i < width; ++i) {
+            if (i < follow.size() && !info.touches[i]) continue;
+            streamed.section = i;
+            callback(streamed);
+        }
+    };
+    WalkHistory(follow, {}, nullptr, !include_all, {}, /*in_walk_order=*/true, stream);
+}
+
+void Changelog::WalkHistory(const std::vector<std::string>& follow_paths,
+                            const OidSet& hidden, CommitCache* cache, bool reject,
+                            const std::vector<Release>& releases, bool in_walk_order,
+                            const WalkSink& sink) {
+    auto timer = stats_.Time("walk");
 
     git_revwalk* walker_raw = nullptr;
     _CHECK_GIT2(git_revwalk_new(&walker_raw, repo_), "Failed to create revwalk");
     std::unique_ptr<git_revwalk, GitRevwalkDeleter> walker(walker_raw);
 
-    _CHECK_GIT2(git_revwalk_push_head(walker.get()), "Failed to push HEAD");
-    git_revwalk_sorting(walker.get(), GIT_SORT_TIME);
+    if (config_.range.empty()) {
+        _CHECK_GIT2(git_revwalk_push_head(walker.get()), "Failed to push HEAD");
+    } else {
+        _CHECK_GIT2(git_revwalk_push_range(walker.get(), config_.range.c_str()),
+                    "Failed to push range " + config_.range);
+    }
+    // Releases are handed from children to parents, so those must come first.
+    git_revwalk_sorting(walker.get(), releases.empty()
+                                          ? GIT_SORT_TIME
+                                          : GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME);
+
+    // Hidden commits and their ancestors are never loaded, unlike commits
+    // dropped after the walk.
+    if (!config_.since.empty()) {
+        git_oid since = ResolveCommit(config_.since);
+        _CHECK_GIT2(git_revwalk_hide(walker.get(), &since),
+                    "Failed to hide " + config_.since);
+    }
+    for (const git_oid& hidden_oid : hidden) {
+        // The changelog may mention commits that are gone after a rebase or
+        // that belong to another repository; those just can't bound the walk.
+        if (git_revwalk_hide(walker.get(), &hidden_oid) < 0) {
+            spdlog::debug("Cannot hide recorded commit {}", FullHash(&hidden_oid));
+        }
+    }
 
+    ReleaseMap release_of;
+    auto record = [&](const git_oid& oid, const CommitInfo& info) {
+        if (!info.type && !info.breaking) return;
+        sink(oid, info, releases.empty() ? 0 : release_of.at(oid));
+    };
+
+    // A commit that touches none of the followed paths can only matter to
+    // the whole-repository section. Rejected commits are not cached either:
+    // the cache is shared with walks that do build that section. The filters
+    // are mapped read-only, so they are checked right in the walk, before a
+    // commit is handed to anything else.
+    FollowSet follow = MakeFollowSet(follow_paths);
+    std::size_t walked = 0;
+    CommitSource walk = [&](git_oid* oid) {
+        if (!NextCommit(walker.get(), oid, &walked)) return false;
+        stats_.Add(Counter::kCommitsVisited);
+        return true;
+    };
+
+    // Rejected commits still pass their release on, so releases are
+    // assigned over the whole walk first.
+    std::vector<git_oid> walk_order;
+    if (!releases.empty()) {
+        walk_order = AssignReleases(walk, releases, &release_of);
+        walk = [&walk_order, pos = std::size_t{0}](git_oid* oid) mutable {
+            if (pos == walk_order.size()) return false;
+            *oid = walk_order[pos++];
+            return true;
+        };
+    }
+
+    CommitSource next = [&](git_oid* oid) {
+        while (walk(oid)) {
+            if (!reject || !RejectedByBloom(*oid, follow.keys)) return true;
+        }
+        return false;
+    };
+
+    // Entries are ordered by the sections' sets, so commits may be loaded in
+    // any order.
+    std::vector<git_oid> pack_ordered;
+    std::vector<std::size_t> walk_positions;
+    if (config_.pack_order) {
+        pack_ordered =
+            CollectInPackOrder(next, in_walk_order ? &walk_positions : nullptr);
+        next = [&pack_ordered, pos = std::size_t{0}](git_oid* oid) mutable {
+            if (pos == pack_ordered.size()) return false;
+            *oid = pack_ordered[pos++];
+            return true;
+        };
+    }
+
+    // Every collector hands commits on in the order `next` produced them.
+    // Commits loaded in pack order are held back until those walked before
+    // them are in, if the sink needs walk order.
+    using HeldCommit = std::pair<git_oid, CommitInfo>;
+    std::vector<std::unique_ptr<HeldCommit>> held(walk_positions.size());
+    std::vector<bool> arrived(walk_positions.size());
+    std::size_t received = 0;
+    std::size_t next_in_walk = 0;
+    CommitSink collect = [&](const git_oid& oid, const CommitInfo& info) {
+        if (walk_positions.empty()) {
+            record(oid, info);
+            return;
+        }
+        std::size_t pos = walk_positions[received++];
+        arrived[pos] = true;
+        if (info.type || info.breaking) {
+            held[pos] = std::make_unique<HeldCommit>(oid, info);
+        }
+        for (; next_in_walk < arrived.size() && arrived[next_in_walk]; ++next_in_walk) {
+            if (!held[next_in_walk]) continue;
+            std::unique_ptr<HeldCommit> ready = std::move(held[next_in_walk]);
+            record(ready->first, ready->second);
+        }
+    };
+
+    if (config_.pipeline_depth > 0) {
+        ClassifyPipelined(next, follow, cache, collect);
+        return;
+    }
+    if (config_.jobs > 1) {
+        ClassifyInParallel(next, follow, cache, collect);
+        return;
+    }
+
+    UniqueOdb odb = OpenOdb(repo_);
     git_oid oid;
-    while (git_revwalk_next(&oid, walker.get()) == 0) {
-        git_commit* commit_raw = nullptr;
-        _CHECK_GIT2(git_commit_lookup(&commit_raw, repo_, &oid),
-                    "Failed to lookup commit");
-        UniqueCommit commit(commit_raw);
+    while (next(&oid)) {
+        CommitInfo info;
+        if (cache && cache->Lookup(oid, &info)) {
+            stats_.Add(Counter::kCacheHits);
+        } else {
+            info = ClassifyCommit(repo_, odb.get(), oid, follow);
+            if (cache) cache->Insert(oid, info);
+        }
+        collect(oid, info);
+    }
+}
 
-        if (!follow_path.empty() && !CommitTouchesPath(commit.get(), follow_path)) {
-            continue;
+bool Changelog::NextCommit(git_revwalk* walker, git_oid* oid,
+                           std::size_t* walked) const {
+    if (config_.max_count > 0 && *walked >= config_.max_count) return false;
+    if (git_revwalk_next(oid, walker) != 0) return false;
+    ++*walked;
+    return true;
+}
+
+std::vector<git_oid> Changelog::AssignReleases(const CommitSource& walk,
+                                               const std::vector<Release>& releases,
+                                               ReleaseMap* release_of) const {
+    auto timer = stats_.Time("assign_releases");
+    const auto unreleased = static_cast<std::uint32_t>(releases.size());
+
+    // The oldest release known to reach each commit not walked yet. Entries
+    // are dropped once walked, so this only holds the walk's frontier.
+    ReleaseMap pending;
+    for (std::uint32_t r = 0; r < unreleased; ++r) {
+        pending.emplace(releases[r].commit, r);
+    }
+
+    UniqueOdb odb = OpenOdb(repo_);
+    std::vector<git_oid> oids;
+    git_oid oid;
+    while (walk(&oid)) {
+        oids.push_back(oid);
+        std::uint32_t release = unreleased;
+        auto it = pending.find(oid);
+        if (it != pending.end()) {
+            release = it->second;
+            pending.erase(it);
+        }
+        (*release_of)[oid] = release;
+        if (release == unreleased) continue;
+
+        UniqueOdbObject object = ReadCommitObject(odb.get(), oid);
+        stats_.Add(Counter::kCommitsLookedUp);
+        ForEachParent(ObjectData(object.get()), [&](std::string_view hex) {
+            auto [parent, inserted] = pending.emplace(ParseHexOid(hex), release);
+            if (!inserted) parent->second = std::min(parent->second, release);
+        });
+    }
+    return oids;
+}
+
+std::vector<git_oid> Changelog::CollectInPackOrder(
+    const CommitSource& next, std::vector<std::size_t>* walk_positions) const {
+    auto timer = stats_.Time("pack_order");
+    PackIndex index(std::string(git_repository_commondir(repo_)) + "objects/pack");
+    constexpr PackIndex::Location kUnpacked = {UINT32_MAX, 0};
+
+    struct Located {
+        PackIndex::Location location;
+        git_oid oid;
+        std::size_t walk_position;
+    };
+    std::vector<Located> located;
+    git_oid oid;
+    while (next(&oid)) {
+        located.push_back({index.Find(oid).value_or(kUnpacked), oid, located.size()});
+    }
+    std::stable_sort(located.begin(), located.end(), [](const auto& a, const auto& b) {
+        return a.location < b.location;
+    });
+
+    std::vector<git_oid> oids;
+    oids.reserve(located.size());
+    if (walk_positions) walk_positions->reserve(located.size());
+    for (const Located& commit : located) {
+        oids.push_back(commit.oid);
+        if (walk_positions) walk_positions->push_back(commit.walk_position);
+    }
+    return oids;
+}
+
+git_oid Changelog::ResolveCommit(const std::string& rev) const {
+    git_object* object_raw = nullptr;
+    _CHECK_GIT2(git_revparse_single(&object_raw, repo_, rev.c_str()),
+                "Failed to resolve " + rev);
+    UniqueObject object(object_raw);
+    // Annotated tags name a tag object, not the commit it points at.
+    git_object* commit_raw = nullptr;
+    _CHECK_GIT2(git_object_peel(&commit_raw, object.get(), GIT_OBJECT_COMMIT),
+                rev + " does not name a commit");
+    UniqueObject commit(commit_raw);
+    return *git_object_id(commit.get());
+}
+
+void Changelog::ClassifyInParallel(const CommitSource& next,
+                                   const FollowSet& follow, CommitCache* cache,
+                                   const CommitSink& sink) const {
+    // Large enough to amortize the hand-off, small enough to keep every
+    // worker busy on short histories.
+    constexpr std::size_t kBatchSize = 256;
+
+    struct Batch {
+        std::vector<git_oid> oids;
+        std::vector<CommitInfo> infos;
+        // Set for commits resolved from the cache on the walking thread.
+        std::vector<bool> cached;
+        bool done = false;
+    };
+
+    // A deque keeps references to the other batches valid while new ones are
+    // appended and consumed ones popped, so workers can fill them in without
+    // holding the lock.
+    std::deque<Batch> batches;
+    std::queue<Batch*> pending;
+    std::mutex mu;
+    std::condition_variable work_ready;
+    std::condition_variable batch_done;
+    bool walk_finished = false;
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        std::unique_ptr<git_repository, GitRepoDeleter> repo;
+        UniqueOdb odb;
+        try {
+            // libgit2 objects can't be shared across threads, so each worker
+            // loads commits through its own repository handle.
+            repo.reset(OpenRepository());
+            odb = OpenOdb(repo.get());
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mu);
+            if (!error) error = std::current_exception();
+            batch_done.notify_all();
+            return;
+        }
+
+        while (true) {
+            Batch* batch = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mu);
+                work_ready.wait(lock, [&] { return !pending.empty() || walk_finished; });
+                if (pending.empty() || error) return;
+                batch = pending.front();
+                pending.pop();
+            }
+
+            try {
+                auto timer = stats_.Time("classify_batch");
+                for (std::size_t i = 0; i < batch->oids.size(); ++i) {
+                    if (!batch->cached[i]) {
+                        batch->infos[i] = ClassifyCommit(repo.get(), odb.get(),
+                                                         batch->oids[i], follow);
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mu);
+                if (!error) error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mu);
+            batch->done = true;
+            batch_done.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    auto stop_workers = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            walk_finished = true;
+        }
+        work_ready.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+        workers.clear();
+    };
+
+    // Hands finished batches to `sink` in walk order, waiting for the oldest
+    // one while more than `keep` are queued.
+    auto drain = [&](std::size_t keep) {
+        while (!batches.empty()) {
+            Batch& batch = batches.front();
+            {
+                std::unique_lock<std::mutex> lock(mu);
+                if (batches.size() > keep) {
+                    batch_done.wait(lock, [&] { return batch.done || error; });
+                }
+                if (error) std::rethrow_exception(error);
+                if (!batch.done) return;
+            }
+            for (std::size_t i = 0; i < batch.oids.size(); ++i) {
+                if (cache && !batch.cached[i]) cache->Insert(batch.oids[i], batch.infos[i]);
+                sink(batch.oids[i], batch.infos[i]);
+            }
+            batches.pop_front();
+        }
+    };
+
+    try {
+        for (int i = 0; i < config_.jobs; ++i) {
+            workers.emplace_back(worker);
+        }
+
+        // Enough batches to keep every worker busy while the walk runs ahead,
+        // without the walk queueing up the whole history on a fast revwalk.
+        const std::size_t max_batches = 2 * static_cast<std::size_t>(config_.jobs);
+        git_oid oid;
+        bool more = true;
+        while (more) {
+            drain(max_batches - 1);
+            Batch& batch = batches.emplace_back();
+            batch.oids.reserve(kBatchSize);
+            while (batch.oids.size() < kBatchSize && (more = next(&oid))) {
+                batch.oids.push_back(oid);
+            }
+            batch.infos.resize(batch.oids.size());
+            batch.cached.resize(batch.oids.size());
+            for (std::size_t i = 0; cache && i < batch.oids.size(); ++i) {
+                batch.cached[i] = cache->Lookup(batch.oids[i], &batch.infos[i]);
+                if (batch.cached[i]) stats_.Add(Counter::kCacheHits);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                pending.push(&batch);
+            }
+            work_ready.notify_one();
+        }
+
+        drain(0);
+    } catch (...) {
+        stop_workers();
+        throw;
+    }
+    stop_workers();
+}
+
+void Changelog::ClassifyPipelined(const CommitSource& next,
+                                  const FollowSet& follow, CommitCache* cache,
+                                  const CommitSink& sink) const {
+    // Commits move from stage to stage in batches, so each hand-off costs
+    // one queue operation per batch rather than one per commit.
+    struct Batch {
+        // Position of the batch in the walk stage's output.
+        std::size_t sequence = 0;
+        std::vector<git_oid> oids;
+        // Set for commits the walk stage resolved from the cache; the later
+        // stages pass them through.
+        std::vector<bool> cached;
+        std::vector<UniqueOdbObject> objects;
+        std::vector<CommitInfo> infos;
+    };
+    using BatchPtr = std::unique_ptr<Batch>;
+
+    const std::size_t batch_size = std::max<std::size_t>(1, config_.pipeline_batch);
+    const int classifiers = std::max(1, config_.jobs);
+    BoundedQueue<BatchPtr> walked(config_.pipeline_depth);
+    BoundedQueue<BatchPtr> loaded(config_.pipeline_depth);
+    BoundedQueue<BatchPtr> classified(config_.pipeline_depth);
+
+    std::mutex error_mu;
+    std::exception_ptr error;
+    // Keeps the first failure and winds every stage down.
+    auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(error_mu);
+            if (!error) error = std::current_exception();
         }
+        walked.Cancel();
+        loaded.Cancel();
+        classified.Cancel();
+    };
 
-        const char* summary = git_commit_summary(commit.get());
-        if (!summary) continue;
+    // Commits read by the load stage may be released by any classifier, so
+    // its repository stays open until every stage is done.
+    std::unique_ptr<git_repository, GitRepoDeleter> load_repo(OpenRepository());
+
+    // Walk: batches of OIDs from `next`, with cached commits resolved on the
+    // spot.
+    auto walk_stage = [&]() {
+        git_oid oid;
+        bool more = true;
+        std::size_t sequence = 0;
+        while (more) {
+            auto batch = std::make_unique<Batch>();
+            batch->sequence = sequence++;
+            {
+                auto timer = stats_.Time("walk_batch");
+                batch->oids.reserve(batch_size);
+                while (batch->oids.size() < batch_size && (more = next(&oid))) {
+                    batch->oids.push_back(oid);
+                }
+                batch->cached.resize(batch->oids.size());
+                batch->infos.resize(batch->oids.size());
+                for (std::size_t i = 0; cache && i < batch->oids.size(); ++i) {
+                    batch->cached[i] = cache->Lookup(batch->oids[i], &batch->infos[i]);
+                    if (batch->cached[i]) stats_.Add(Counter::kCacheHits);
+                }
+            }
+            if (!batch->oids.empty() && !walked.Push(std::move(batch))) return;
+        }
+        walked.Close();
+    };
 
-        if (IsBreakingChange(summary)) {
-            data.has_breaking_change = true;
+    // Load: reads and inflates the objects, overlapping the I/O with the
+    // classification of earlier batches.
+    auto load_stage = [&]() {
+        UniqueOdb odb = OpenOdb(load_repo.get());
+        while (std::optional<BatchPtr> batch = walked.Pop()) {
+            {
+                auto timer = stats_.Time("load_batch");
+                Batch& b = **batch;
+                b.objects.resize(b.oids.size());
+                for (std::size_t i = 0; i < b.oids.size(); ++i) {
+                    if (b.cached[i]) continue;
+                    b.objects[i] = ReadCommitObject(odb.get(), b.oids[i]);
+                    stats_.Add(Counter::kCommitsLookedUp);
+                }
+            }
+            if (!loaded.Push(std::move(*batch))) return;
         }
+        loaded.Close();
+    };
 
-        auto type = CategorizeCommit(summary);
-        if (!type) continue;
+    // Classify: summaries and path checks, on `classifiers` threads. The last
+    // one to finish ends the stream.
+    std::atomic<int> classifiers_left{classifiers};
+    auto classify_stage = [&]() {
+        // Trees are looked up through libgit2 objects, which can't be shared
+        // across threads.
+        std::unique_ptr<git_repository, GitRepoDeleter> repo(OpenRepository());
+        UniqueOdb odb = OpenOdb(repo.get());
+        while (std::optional<BatchPtr> batch = loaded.Pop()) {
+            {
+                auto timer = stats_.Time("classify_batch");
+                Batch& b = **batch;
+                for (std::size_t i = 0; i < b.oids.size(); ++i) {
+                    if (b.cached[i]) continue;
+                    std::string_view data = ObjectData(b.objects[i].get());
+                    b.infos[i] = ClassifyCommitData(repo.get(), odb.get(), b.oids[i],
+                                                    data, follow);
+                    b.objects[i].reset();
+                }
+            }
+            if (!classified.Push(std::move(*batch))) return;
+        }
+        if (classifiers_left.fetch_sub(1) == 1) classified.Close();
+    };
 
-        CommitEntry entry{
-            .summary = summary,
-            .oid = oid,
-            .author_name = git_commit_author(commit.get())->name,
+    auto guarded = [&](auto stage) {
+        return [&fail, stage]() {
+            try {
+                stage();
+            } catch (...) {
+                fail();
+            }
         };
-        data.entries[*type].insert(entry);
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        threads.emplace_back(guarded(walk_stage));
+        threads.emplace_back(guarded(load_stage));
+        for (int i = 0; i < classifiers; ++i) {
+            threads.emplace_back(guarded(classify_stage));
+        }
 
-        spdlog::debug("{} -> {}", CommitTypeNames().at(*type), entry.summary);
+        // Aggregate, on the calling thread. Batches arrive in no particular
+        // order once there are several classifiers, so those that overtook
+        // an earlier one wait for it. At most the batches in flight wait.
+        std::map<std::size_t, BatchPtr> early;
+        std::size_t next_sequence = 0;
+        while (std::optional<BatchPtr> batch = classified.Pop()) {
+            early.emplace((*batch)->sequence, std::move(*batch));
+            for (auto it = early.begin();
+                 it != early.end() && it->first == next_sequence;
+                 it = early.erase(it), ++next_sequence) {
+                const Batch& b = *it->second;
+                for (std::size_t i = 0; i < b.oids.size(); ++i) {
+                    if (cache && !b.cached[i]) cache->Insert(b.oids[i], b.infos[i]);
+                    sink(b.oids[i], b.infos[i]);
+                }
+            }
+        }
+    } catch (...) {
+        fail();
     }
 
-    return data;
+    for (auto& t : threads) {
+        t.join();
+    }
+    if (error) std::rethrow_exception(error);
 }
 
 SemanticVersion Changelog::DetectInitialVersion() const {
-    git_strarray tags = {};
-    int err = git_tag_list(&tags, repo_);
+    auto timer = stats_.Time("detect_version");
+    struct Highest {
+        SemanticVersion version = {0, 0, 0};
+        bool found_any = false;
+        std::uint64_t scanned = 0;
+    } highest;
+
+    // Tags are visited in place, so no list of every tag name is built just
+    // to keep the maximum.
+    int err = git_tag_foreach(
+        repo_,
+        [](const char* name, git_oid*, void* payload) {
+            auto* h = static_cast<Highest*>(payload);
+            ++h->scanned;
+            std::string_view tag_name(name);
+            constexpr std::string_view kTagsPrefix = "refs/tags/";
+            if (StartsWith(tag_name, kTagsPrefix)) {
+                tag_name.remove_prefix(kTagsPrefix.size());
+            }
+            std::optional<SemanticVersion> v = SemanticVersion::TryParse(tag_name);
+            if (v && (!h->found_any || h->version < *v)) {
+                h->version = *v;
+                h->found_any = true;
+            }
+            return 0;
+        },
+        &highest);
+    stats_.Add(Counter::kTagsScanned, highest.scanned);
     if (err < 0) {
         spdlog::debug("No tags found, using default v0.1.0");
         return {0, 1, 0};
     }
 
-    SemanticVersion highest = {0, 0, 0};
-    bool found_any = false;
+    if (!highest.found_any) {
+        spdlog::debug("No semver tags found, using default v0.1.0");
+        return {0, 1, 0};
+    }
+
+    spdlog::debug("Detected latest version from tags: {}", highest.version.ToString());
+    return highest.version;
+}
 
-    for (size_t i = 0; i < tags.count; ++i) {
-        std::string tag_name(tags.strings[i]);
-        try {
-            SemanticVersion v = SemanticVersion::Parse(tag_name);
-            if (!found_any || highest < v) {
-                highest = v;
-                found_any = true;
+std::vector<Changelog::Release> Changelog::ListReleases() const {
+    auto timer = stats_.Time("list_releases");
+    struct Tags {
+        std::vector<std::pair<SemanticVersion, std::string>> semver;
+        std::uint64_t scanned = 0;
+    } tags;
+    int err = git_tag_foreach(
+        repo_,
+        [](const char* name, git_oid*, void* payload) {
+            auto* t = static_cast<Tags*>(payload);
+            ++t->scanned;
+            std::string_view tag_name(name);
+            constexpr std::string_view kTagsPrefix = "refs/tags/";
+            if (StartsWith(tag_name, kTagsPrefix)) {
+                tag_name.remove_prefix(kTagsPrefix.size());
             }
-        } catch (...) {
+            std::optional<SemanticVersion> v = SemanticVersion::TryParse(tag_name);
+            if (v) t->semver.emplace_back(*v, name);
+            return 0;
+        },
+        &tags);
+    stats_.Add(Counter::kTagsScanned, tags.scanned);
+    if (err < 0) {
+        spdlog::debug("No tags found, so every commit is unreleased");
+        return {};
+    }
+    // Spellings of one version such as "v1.0.0" and "1.0.0" are one release;
+    // the first tag name in sort order wins.
+    std::sort(tags.semver.begin(), tags.semver.end());
+
+    std::vector<Release> releases;
+    for (const auto& [version, name] : tags.semver) {
+        if (!releases.empty() && releases.back().version == version) continue;
+
+        // A tag may name a blob that a partial clone left out.
+        git_object* object_raw = nullptr;
+        if (git_revparse_single(&object_raw, repo_, name.c_str()) < 0) {
+            spdlog::debug("Ignoring tag {}, which cannot be resolved", name);
+            continue;
+        }
+        UniqueObject object(object_raw);
+        git_object* commit_raw = nullptr;
+        if (git_object_peel(&commit_raw, object.get(), GIT_OBJECT_COMMIT) < 0) {
+            spdlog::debug("Ignoring tag {}, which does not name a commit", name);
             continue;
         }
+        UniqueObject commit(commit_raw);
+        releases.push_back(Release{
+            version,
+            *git_object_id(commit.get()),
+            FormatDate(git_commit_time(reinterpret_cast<git_commit*>(commit.get()))),
+        });
     }
+    spdlog::debug("Found {} release(s) among {} tag(s)", releases.size(), tags.scanned);
+    return releases;
+}
 
-    git_strarray_free(&tags);
-
-    if (!found_any) {
-        spdlog::debug("No semver tags found, using default v0.1.0");
-        return {0, 1, 0};
+// A changelog already on disk, or what was last written over it when kept
+// resident. The mapping stays valid after the new file is renamed over it, so
+// its bytes are written out directly.
+struct Changelog::ExistingChangelog {
+    MappedFile file;
+    // Owns `body` once the changelog has been rewritten in retained mode.
+    std::string resident;
+    std::string_view body;
+    // Without entries when they come from `index`.
+    std::vector<ParsedSection> sections;
+    // The recorded commits are those of a valid `index` and those in
+    // `recorded`, or only the latter when the markdown was parsed.
+    ChangelogIndex index;
+    OidSet recorded;
+    // MarkdownChecksum() of content(), once known.
+    std::optional<std::uint64_t> checksum;
+
+    bool Records(const git_oid& oid) const {
+        return recorded.count(oid) > 0 || index.Contains(oid);
     }
+    // The whole markdown, header line included.
+    std::string_view content() const {
+        return resident.empty() ? file.data() : std::string_view(resident);
+    }
+    std::size_t recorded_size() const { return recorded.size() + index.size(); }
+};
 
-    spdlog::debug("Detected latest version from tags: {}", highest.ToString());
-    return highest;
-}
-
-std::string Changelog::FormatChangelog(
+void Changelog::FormatChangelog(
+    fmt::memory_buffer* out,
     const std::vector<std::pair<std::string, SectionData>>& sections,
-    const std::string& date) {
-    std::ostringstream out;
-    const auto& type_names = CommitTypeNames();
-
+    const std::string& date, const ExistingChangelog& existing,
+    AtomicFileWriter* file) const {
+    auto timer = stats_.Time("format");
     for (const auto& [section_name, data] : sections) {
-        out << "## " << section_name << " \u2014 " << date << "\n\n";
+        fmt::format_to(std::back_inserter(*out), "## {} \u2014 {}\n\n", section_name,
+                       date);
+        FormatEntries(out, data, existing, file);
+    }
+}
 
-        for (const auto& [type, logs] : data.entries) {
-            if (logs.empty()) continue;
-            out << "### " << type_names.at(type) << "\n\n";
-            for (const auto& log : logs) {
-                out << "- " << FormatEntry(log) << "\n";
+void Changelog::ForEachEntry(const SectionData& data, CommitType type,
+                             const ExistingChangelog& existing,
+                             const std::function<void(const CommitEntry&)>& fn) const {
+    if (data.spilled) {
+        spill_->ForEach(*data.spilled, type, [&](const CommitEntry& entry) {
+            if (!existing.Records(entry.oid)) fn(entry);
+        });
+    } else {
+        for (const auto& log : data.entries[type]) fn(log);
+    }
+}
+
+void Changelog::FormatEntries(fmt::memory_buffer* out, const SectionData& data,
+                              const ExistingChangelog& existing,
+                              AtomicFileWriter* file) const {
+    // Spilled sections may be far larger than memory, so `out` only ever
+    // holds a bounded tail of them.
+    CommitTypeSet types = data.types();
+    for (const auto& spec : kCommitTypeSpecs) {
+        if (!types[CommitTypeIndex(spec.type)]) continue;
+        fmt::format_to(std::back_inserter(*out), "### {}\n\n", spec.name);
+        ForEachEntry(data, spec.type, existing, [&](const CommitEntry& entry) {
+            FormatEntry(out, entry);
+            if (std::size_t n = FlushIfFull(out, file)) {
+                stats_.Add(Counter::kBytesWritten, n);
             }
-            out << "\n";
+        });
+        out->push_back('\n');
+    }
+}
+
+void Changelog::FormatJsonLines(fmt::memory_buffer* out, const DatedSections& group,
+                                const ExistingChangelog& existing,
+                                AtomicFileWriter* file) const {
+    for (const auto& [section, data] : *group.sections) {
+        std::string_view name, version;
+        SplitSectionName(section, &name, &version);
+        for (const auto& spec : kCommitTypeSpecs) {
+            ForEachEntry(data, spec.type, existing, [&](const CommitEntry& entry) {
+                char hex[GIT_OID_SHA1_HEXSIZE];
+                git_oid_fmt(hex, &entry.oid);
+                std::string_view hash(hex, sizeof(hex));
+                out->append(std::string_view("{\"section\":"));
+                AppendJsonString(out, name);
+                out->append(std::string_view(",\"version\":"));
+                AppendJsonString(out, version);
+                out->append(std::string_view(",\"date\":"));
+                AppendJsonString(out, group.date);
+                fmt::format_to(std::back_inserter(*out),
+                               ",\"type\":\"{}\",\"breaking\":{},\"summary\":",
+                               spec.prefix, IsBreakingChange(entry.summary));
+                AppendJsonString(out, entry.summary);
+                out->append(std::string_view(",\"author\":"));
+                AppendJsonString(out, entry.author_name);
+                fmt::format_to(std::back_inserter(*out), ",\"commit\":\"{}\"", hash);
+                if (!config_.url.empty()) {
+                    out->append(std::string_view(",\"url\":"));
+                    AppendJsonString(out,
+                                     fmt::format("{}/commit/{}", config_.url, hash));
+                }
+                out->append(std::string_view("}\n"));
+                if (std::size_t n = FlushIfFull(out, file)) {
+                    stats_.Add(Counter::kBytesWritten, n);
+                }
+            });
         }
     }
+}
 
-    return out.str();
+void Changelog::FormatBinary(fmt::memory_buffer* out, const DatedSections& group,
+                             const ExistingChangelog& existing,
+                             AtomicFileWriter* file) const {
+    for (const auto& [section, data] : *group.sections) {
+        std::string_view name, version_str;
+        SplitSectionName(section, &name, &version_str);
+        std::optional<SemanticVersion> version = SemanticVersion::TryParse(version_str);
+        AppendSizedString(out, name);
+        AppendLittleEndian<std::int32_t>(out, version ? version->major : -1);
+        AppendLittleEndian<std::int32_t>(out, version ? version->minor : -1);
+        AppendLittleEndian<std::int32_t>(out, version ? version->patch : -1);
+        AppendSizedString(out, group.date);
+        out->push_back(static_cast<char>(data.has_breaking_change ? kBinaryFlagBreaking
+                                                                  : 0));
+        AppendLittleEndian(out, static_cast<std::uint64_t>(data.size()));
+        for (const auto& spec : kCommitTypeSpecs) {
+            ForEachEntry(data, spec.type, existing, [&](const CommitEntry& entry) {
+                out->push_back(static_cast<char>(CommitTypeIndex(spec.type)));
+                out->push_back(static_cast<char>(
+                    IsBreakingChange(entry.summary) ? kBinaryFlagBreaking : 0));
+                out->append(reinterpret_cast<const char*>(entry.oid.id),
+                            reinterpret_cast<const char*>(entry.oid.id) +
+                                GIT_OID_SHA1_SIZE);
+                AppendSizedString(out, entry.summary);
+                AppendSizedString(out, entry.author_name);
+                if (std::size_t n = FlushIfFull(out, file)) {
+                    stats_.Add(Counter::kBytesWritten, n);
+                }
+            });
+        }
+    }
 }
 
-std::string Changelog::ReadChangelogFile(const std::string& fpath) {
-    std::ifstream file(fpath);
-    if (!file.is_open()) {
-        return "";
+void Changelog::WriteFormats(const std::string& output, std::uint64_t new_checksum,
+                             const std::vector<DatedSections>& groups,
+                             const ExistingChangelog& existing) const {
+    auto timer = stats_.Time("write_formats");
+    // Each companion starts with the checksum of the markdown it matches.
+    // One that matches the markdown as this run found it only gains the new
+    // sections in front of what it holds, like the markdown. Any other, left
+    // behind by a failed run or asked for only now, is rebuilt from the
+    // markdown as just written, so it neither misses nor repeats entries.
+    bool had_markdown = !existing.body.empty();
+    std::uint64_t old_checksum = 0;
+    if (had_markdown) {
+        old_checksum = existing.checksum ? *existing.checksum
+                                         : MarkdownChecksum({existing.content()});
     }
 
-    std::string content;
-    std::string line;
-    bool first_line = true;
-    while (std::getline(file, line)) {
-        if (first_line) {
-            first_line = false;
-            // Skip the "# Changelog" header line.
-            if (line.find("# Changelog") == 0) continue;
+    // A rebuild needs every section of the changelog in memory, so the
+    // markdown is only read back and parsed once a companion turns out not to
+    // match.
+    MappedFile written;
+    std::vector<ParsedSection> parsed;
+    std::vector<std::vector<std::pair<std::string, SectionData>>> parsed_sections;
+    std::vector<DatedSections> parsed_groups;
+    auto all_groups = [&]() -> const std::vector<DatedSections>& {
+        if (!parsed.empty()) return parsed_groups;
+        written = MappedFile(output);
+        parsed = ParseChangelogStructured(ChangelogBody(written.data()));
+        parsed_sections.resize(parsed.size());
+        for (std::size_t i = 0; i < parsed.size(); ++i) {
+            ParsedSection& sec = parsed[i];
+            SectionData data;
+            data.entries = std::move(sec.entries);
+            data.has_breaking_change = sec.has_breaking_change;
+            std::string name = sec.name;
+            if (sec.version) name += "@" + sec.version->ToString();
+            parsed_sections[i].emplace_back(std::move(name), std::move(data));
+            parsed_groups.push_back({&parsed_sections[i], sec.date});
         }
-        content += line + "\n";
+        return parsed_groups;
+    };
+    // Parsed entries are all in the markdown, so none may be filtered out.
+    const ExistingChangelog nothing_recorded;
+
+    using Formatter = void (Changelog::*)(fmt::memory_buffer*, const DatedSections&,
+                                          const ExistingChangelog&,
+                                          AtomicFileWriter*) const;
+    using HeaderFor = std::string (*)(std::uint64_t checksum);
+    auto write = [&](const std::string& path, HeaderFor header_for,
+                     Formatter format) {
+        MappedFile old;
+        std::string_view rest;
+        bool rebuild = false;
+        if (had_markdown) {
+            old = MappedFile(path);
+            rest = old.data();
+            std::string old_header = header_for(old_checksum);
+            if (StartsWith(rest, old_header)) {
+                rest.remove_prefix(old_header.size());
+            } else {
+                if (rest.empty()) {
+                    spdlog::info("Building {} from all of {}", path, output);
+                } else {
+                    spdlog::warn("Rebuilding {}, which does not match {}", path,
+                                 output);
+                }
+                rest = {};
+                rebuild = true;
+            }
+        }
+
+        AtomicFileWriter file(path);
+        fmt::memory_buffer out;
+        out.append(header_for(new_checksum));
+        for (const DatedSections& group : rebuild ? all_groups() : groups) {
+            (this->*format)(&out, group, rebuild ? nothing_recorded : existing, &file);
+        }
+        file.Append({{out.data(), out.size()}, rest});
+        file.Commit();
+        stats_.Add(Counter::kBytesWritten, out.size() + rest.size());
+        spdlog::info("Wrote {}", path);
+    };
+
+    if (config_.jsonl) {
+        write(
+            CompanionPath(output, ".jsonl"),
+            [](std::uint64_t checksum) {
+                return fmt::format("{{\"markdown_checksum\":\"{:016x}\"}}\n", checksum);
+            },
+            &Changelog::FormatJsonLines);
     }
+    if (config_.binary) {
+        write(
+            CompanionPath(output, ".bin"),
+            [](std::uint64_t checksum) {
+                fmt::memory_buffer header;
+                header.append(std::string_view(kBinaryMagic, sizeof(kBinaryMagic)));
+                AppendLittleEndian(&header, kBinaryFormatVersion);
+                AppendLittleEndian(&header, std::uint32_t{0});
+                AppendLittleEndian(&header, checksum);
+                return fmt::to_string(header);
+            },
+            &Changelog::FormatBinary);
+    }
+}
 
+std::string_view Changelog::ChangelogBody(std::string_view content) {
+    // Skip the "# Changelog" header line.
+    if (StartsWith(content, "# Changelog")) {
+        std::size_t eol = content.find('\n');
+        content.remove_prefix(eol == std::string_view::npos ? content.size() : eol + 1);
+    }
     return content;
 }
 
 std::vector<ParsedSection> Changelog::ParseChangelogStructured(
-    const std::string& content) {
+    std::string_view content) {
     std::vector<ParsedSection> sections;
 
     ParsedSection* cur = nullptr;
     std::optional<CommitType> cur_type;
 
-    // Match both old and new formats:
+    // Recognizes both old and new formats:
     //   ## repo_name — YYYY-MM-DD
     //   ## repo_name@vX.Y.Z — YYYY-MM-DD
-    std::regex section_re(
-        R"(^## (.+?)(?:@(v\d+\.\d+\.\d+))?\s+(?:--|—)\s+(\d{4}-\d{2}-\d{2})$)");
-    std::regex type_re(R"(^### (\w+)$)");
-    std::regex entry_re(
-        R"(^- (.+) by \*\*(.+)\*\* in \[#([a-f0-9]+)\]\((.+)/commit/([a-f0-9]+)\)$)");
-    std::regex old_entry_re(
-        R"(^- (.+) \(\[#([a-f0-9]+)\]\((.+)/commit/([a-f0-9]+)\)\)$)");
-
-    std::istringstream stream(content);
-    std::string line;
-    const auto& prefixes = PrefixToCommitType();
-
-    while (std::getline(stream, line)) {
-        std::smatch match;
-
-        if (std::regex_match(line, match, section_re)) {
-            sections.emplace_back();
-            cur = &sections.back();
-            cur->name = match[1].str();
-            if (match[2].matched) {
-                cur->version = SemanticVersion::Parse(match[2].str());
-            }
-            cur->date = match[3].str();
+    //   ### Type
+    //   - summary by **author** in [#short](url/commit/full)
+    //   - summary ([#short](url/commit/full))      (changelog@v0.1.0)
+    std::size_t pos = 0;
+    while (pos < content.size()) {
+        std::size_t eol = content.find('\n', pos);
+        if (eol == std::string_view::npos) eol = content.size();
+        std::string_view line = content.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        if (StartsWith(line, "## ")) {
+            ParsedSection section;
+            if (!ParseHeaderLine(line, &section)) continue;
+            cur = &sections.emplace_back(std::move(section));
             cur_type = std::nullopt;
-        } else if (std::regex_match(line, match, type_re)) {
-            std::string type_str = match[1].str();
-            std::transform(type_str.begin(), type_str.end(), type_str.begin(),
-                           ::tolower);
-            auto it = prefixes.find(type_str);
-            cur_type =
-                (it != prefixes.end()) ? std::optional(it->second) : std::nullopt;
-        } else if (std::regex_match(line, match, entry_re) && cur_type && cur) {
-            git_oid oid;
-            git_oid_fromstr(&oid, match[5].str().c_str());
-            const CommitEntry entry = {
-                .summary = match[1].str(),
-                .oid = oid,
-                .author_name = match[2].str(),
-            };
-            cur->entries[*cur_type].insert(entry);
-            // Detect breaking change from preserved commit summary.
-            if (entry.summary.find("!:") != std::string::npos) {
-                cur->has_breaking_change = true;
+        } else if (StartsWith(line, "### ")) {
+            std::string_view type_str = line.substr(4);
+            if (type_str.empty() || !std::all_of(type_str.begin(), type_str.end(), IsWord)) {
+                continue;
             }
-        } else if (std::regex_match(line, match, old_entry_re) && cur_type && cur) {
-            // Changelog written using version v0.1.0
-            git_oid oid;
-            git_oid_fromstr(&oid, match[4].str().c_str());
+            cur_type = MatchCommitPrefix(type_str);
+        } else if (StartsWith(line, "- ") && cur_type && cur) {
+            EntryView view;
+            if (!ParseEntry(line, &view) && !ParseOldEntry(line, &view)) continue;
+
+            git_oid oid = {};
+            git_oid_fromstrn(&oid, view.hash.data(),
+                             std::min<std::size_t>(view.hash.size(), GIT_OID_SHA1_HEXSIZE));
             const CommitEntry entry = {
-                .summary = match[1].str(),
+                .summary = view.summary,
                 .oid = oid,
-                .author_name = "",
+                .author_name = view.author_name,
             };
             cur->entries[*cur_type].insert(entry);
             // Detect breaking change from preserved commit summary.
-            if (entry.summary.find("!:") != std::string::npos) {
+            if (entry.summary.find("!:") != std::string_view::npos) {
                 cur->has_breaking_change = true;
             }
         }
@@ -422,26 +1967,43 @@ std::vector<ParsedSection> Changelog::ParseChangelogStructured(
     return sections;
 }
 
-std::set<CommitEntry> Changelog::FlattenEntries(
-    const std::vector<ParsedSection>& sections) {
-    std::set<CommitEntry> all;
+OidSet Changelog::FlattenEntries(const std::vector<ParsedSection>& sections) {
+    OidSet all;
     for (const auto& sec : sections) {
-        for (const auto& [type, logs] : sec.entries) {
-            all.insert(logs.begin(), logs.end());
+        for (const auto& logs : sec.entries.by_type) {
+            for (const auto& log : logs) {
+                all.insert(log.oid);
+            }
         }
     }
     return all;
 }
 
 SectionData Changelog::FilterNewEntries(const SectionData& current,
-                                        const std::set<CommitEntry>& existing_entries) {
+                                        const ExistingChangelog& existing) const {
     SectionData result;
-    for (const auto& [type, logs] : current.entries) {
-        for (const auto& log : logs) {
-            if (existing_entries.find(log) == existing_entries.end()) {
-                result.entries[type].insert(log);
+    if (current.spilled) {
+        result.spilled = current.spilled;
+        for (const auto& spec : kCommitTypeSpecs) {
+            std::size_t index = CommitTypeIndex(spec.type);
+            if (current.spilled_counts[index] == 0) continue;
+            std::size_t& count = result.spilled_counts[index];
+            spill_->ForEach(*current.spilled, spec.type, [&](const CommitEntry& log) {
+                if (existing.Records(log.oid)) return;
+                ++count;
+                if (log.summary.find("!:") != std::string_view::npos) {
+                    result.has_breaking_change = true;
+                }
+            });
+        }
+        return result;
+    }
+    for (std::size_t i = 0; i < kCommitTypeCount; ++i) {
+        for (const auto& log : current.entries.by_type[i]) {
+            if (!existing.Records(log.oid)) {
+                result.entries.by_type[i].insert(log);
                 // Recompute breaking-change flag from filtered entries only.
-                if (log.summary.find("!:") != std::string::npos) {
+                if (log.summary.find("!:") != std::string_view::npos) {
                     result.has_breaking_change = true;
                 }
             }
@@ -450,7 +2012,240 @@ SectionData Changelog::FilterNewEntries(const SectionData& current,
     return result;
 }
 
-void Changelog::Generate() {
+std::vector<Changelog::Target> Changelog::ParseManifest(std::string_view content) {
+    std::vector<Target> targets;
+    while (!content.empty()) {
+        std::size_t eol = content.find('\n');
+        std::string_view line = content.substr(0, eol);
+        content.remove_prefix(eol == std::string_view::npos ? content.size() : eol + 1);
+
+        std::vector<std::string> fields;
+        std::size_t i = 0;
+        while (i < line.size()) {
+            while (i < line.size() && IsSpace(line[i])) ++i;
+            std::size_t start = i;
+            while (i < line.size() && !IsSpace(line[i])) ++i;
+            if (i > start) fields.emplace_back(line.substr(start, i - start));
+        }
+        if (fields.empty() || fields.front().front() == '#') continue;
+
+        Target& target = targets.emplace_back();
+        target.output = std::move(fields.front());
+        target.follow.assign(std::make_move_iterator(fields.begin() + 1),
+                             std::make_move_iterator(fields.end()));
+    }
+    return targets;
+}
+
+void Changelog::Generate() { GenerateBatch({{config_.output, config_.follow}}); }
+
+void Changelog::GenerateBatch(const std::vector<Target>& targets) {
+    auto generate_timer = stats_.Time("generate");
+
+    WalkPlan plan = PlanWalk(targets);
+    // Rebuilt changelogs start from nothing.
+    std::vector<Release> releases;
+    std::vector<ExistingChangelog> existing;
+    if (config_.by_tag) {
+        releases = ListReleases();
+        existing.resize(targets.size());
+    } else {
+        existing = LoadExisting(targets);
+    }
+
+    // In incremental mode the recorded commits bound the walk; their history
+    // was already processed by the run that wrote them.
+    OidSet hidden;
+    if (config_.incremental) hidden = RecordedByAll(existing);
+
+    std::unique_ptr<CommitCache> cache;
+    if (!config_.cache.empty()) {
+        auto timer = stats_.Time("load_cache");
+        cache = std::make_unique<CommitCache>(config_.cache, plan.paths);
+    }
+
+    UpdateTargets(targets, plan, existing, hidden, cache.get(), /*retain=*/false,
+                  releases);
+}
+
+void Changelog::Watch(const std::vector<Target>& targets,
+                      std::chrono::milliseconds poll_interval,
+                      const std::function<bool()>& should_stop) {
+    WalkPlan plan = PlanWalk(targets);
+    // Only the first generation is by release; later commits are unreleased
+    // until the next run.
+    std::vector<Release> releases;
+    std::vector<ExistingChangelog> existing;
+    if (config_.by_tag) {
+        releases = ListReleases();
+        existing.resize(targets.size());
+    } else {
+        existing = LoadExisting(targets);
+    }
+
+    std::unique_ptr<CommitCache> cache;
+    if (!config_.cache.empty()) {
+        auto timer = stats_.Time("load_cache");
+        cache = std::make_unique<CommitCache>(config_.cache, plan.paths);
+    }
+
+    git_oid head = HeadOid();
+    {
+        auto timer = stats_.Time("generate");
+        OidSet hidden;
+        if (config_.incremental) hidden = RecordedByAll(existing);
+        UpdateTargets(targets, plan, existing, hidden, cache.get(), /*retain=*/true,
+                      releases);
+    }
+
+    DirectoryWatcher watcher(RefDirectories());
+    spdlog::info("Watching {} for new commits", config_.repo);
+    while (!should_stop()) {
+        watcher.Wait(poll_interval);
+        if (should_stop()) break;
+
+        // Ref updates show up as several events (lock file, rename, reflog),
+        // and HEAD may have moved back and forth in between; only its current
+        // value matters.
+        git_oid current;
+        try {
+            current = HeadOid();
+        } catch (const std::exception& err) {
+            spdlog::debug("Cannot resolve HEAD yet: {}", err.what());
+            continue;
+        }
+        if (git_oid_equal(&current, &head)) continue;
+
+        // Everything up to the last seen HEAD is already folded in. If that
+        // commit is no longer an ancestor, the walk widens to whatever is
+        // not behind it, and entries that are already recorded are dropped.
+        // Rolled per update, so a daemon's stats do not grow with its uptime.
+        stats_.Reset();
+        try {
+            auto timer = stats_.Time("update");
+            UpdateTargets(targets, plan, existing, OidSet{head}, cache.get(),
+                          /*retain=*/true);
+            head = current;
+        } catch (const std::exception& err) {
+            spdlog::error("Failed to update changelogs: {}", err.what());
+        }
+    }
+}
+
+Changelog::WalkPlan Changelog::PlanWalk(const std::vector<Target>& targets) {
+    WalkPlan plan;
+    plan.index.resize(targets.size());
+    for (std::size_t t = 0; t < targets.size(); ++t) {
+        plan.whole_repo = plan.whole_repo || targets[t].follow.empty();
+        for (const auto& path : targets[t].follow) {
+            auto it = std::find(plan.paths.begin(), plan.paths.end(), path);
+            plan.index[t].push_back(static_cast<std::size_t>(it - plan.paths.begin()));
+            if (it == plan.paths.end()) plan.paths.push_back(path);
+        }
+    }
+    return plan;
+}
+
+std::vector<Changelog::ExistingChangelog> Changelog::LoadExisting(
+    const std::vector<Target>& targets) {
+    auto timer = stats_.Time("parse_changelog");
+    std::vector<ExistingChangelog> existing(targets.size());
+    for (std::size_t t = 0; t < targets.size(); ++t) {
+        ExistingChangelog& e = existing[t];
+        e.file = MappedFile(targets[t].output);
+        e.body = ChangelogBody(e.file.data());
+        stats_.Add(Counter::kBytesRead, e.file.data().size());
+
+        // An index that matches the markdown saves parsing it; only the
+        // header lines it points at are read.
+        if (config_.index && !e.file.data().empty()) {
+            e.index = ChangelogIndex(IndexPath(targets[t].output), e.file.data());
+        }
+        if (e.index.valid()) {
+            e.checksum = e.index.checksum();
+            std::size_t body_begin = e.file.data().size() - e.body.size();
+            const auto& offsets = e.index.header_offsets();
+            bool headers_ok = (offsets.empty() || offsets.front() >= body_begin) &&
+                              ParseHeadersAt(e.file.data(), offsets, &e.sections);
+            std::optional<SemanticVersion> front_version;
+            if (headers_ok && !e.sections.empty()) {
+                front_version = e.sections.front().version;
+            }
+            headers_ok = headers_ok && front_version == e.index.last_version();
+            if (headers_ok) continue;
+            spdlog::debug("Changelog index of {} does not fit it", targets[t].output);
+            e.index = ChangelogIndex();
+            e.sections.clear();
+        }
+        e.sections = ParseChangelogStructured(e.body);
+        e.recorded = FlattenEntries(e.sections);
+    }
+    return existing;
+}
+
+// A shared walk can only stop at commits that every target has recorded, and
+// at a HEAD whose history every target was generated from.
+OidSet Changelog::RecordedByAll(const std::vector<ExistingChangelog>& existing) {
+    if (existing.empty()) return {};
+    const ExistingChangelog& first = existing.front();
+    OidSet common;
+    auto add_if_common = [&](const git_oid& oid) {
+        for (std::size_t t = 1; t < existing.size(); ++t) {
+            if (!existing[t].Records(oid)) return;
+        }
+        common.insert(oid);
+    };
+    for (const git_oid& oid : first.recorded) add_if_common(oid);
+    for (std::size_t i = 0; i < first.index.size(); ++i) {
+        add_if_common(first.index.oid(i));
+    }
+
+    const git_oid& head = first.index.head();
+    bool common_head = first.index.valid() && !git_oid_is_zero(&head);
+    for (std::size_t t = 1; t < existing.size() && common_head; ++t) {
+        common_head = existing[t].index.valid() &&
+                      git_oid_equal(&existing[t].index.head(), &head);
+    }
+    if (common_head) common.insert(head);
+    return common;
+}
+
+git_oid Changelog::HeadOid() const {
+    git_oid oid;
+    _CHECK_GIT2(git_reference_name_to_id(&oid, repo_, "HEAD"),
+                "Failed to resolve HEAD");
+    return oid;
+}
+
+std::vector<std::string> Changelog::RefDirectories() const {
+    // HEAD lives in the git directory, while packed-refs and refs/ are
+    // shared by every worktree and live in the common directory.
+    std::string gitdir = git_repository_path(repo_);
+    std::string commondir = git_repository_commondir(repo_);
+    std::vector<std::string> dirs = {gitdir, commondir, commondir + "refs/heads"};
+
+    // Branches with slashes in their names are stored in subdirectories.
+    git_reference* head_raw = nullptr;
+    if (git_reference_lookup(&head_raw, repo_, "HEAD") == 0) {
+        UniqueReference head(head_raw);
+        const char* target = git_reference_symbolic_target(head.get());
+        std::string_view branch = target ? target : "";
+        std::size_t slash = branch.rfind('/');
+        if (slash != std::string_view::npos) {
+            dirs.push_back(commondir + std::string(branch.substr(0, slash)));
+        }
+    }
+
+    std::sort(dirs.begin(), dirs.end());
+    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+    return dirs;
+}
+
+void Changelog::UpdateTargets(const std::vector<Target>& targets,
+                              const WalkPlan& plan,
+                              std::vector<ExistingChangelog>& existing,
+                              const OidSet& hidden, CommitCache* cache, bool retain,
+                              const std::vector<Release>& releases) {
     // Get today's date.
     auto now = std::chrono::system_clock::now();
     std::time_t now_t = std::chrono::system_clock::to_time_t(now);
@@ -460,35 +2255,129 @@ void Changelog::Generate() {
     std::strftime(date_buf, sizeof(date_buf), "%Y-%m-%d", &tm);
     std::string today(date_buf);
 
-    // Collect current git logs.
-    std::map<std::string, SectionData> current_sections;
-    if (config_.follow.empty()) {
-        spdlog::debug("Getting logs for entire repository");
-        current_sections[config_.repo_name] = GetGitLogs();
-    } else {
-        for (const auto& path : config_.follow) {
-            spdlog::debug("Getting logs for path: {}", path);
-            current_sections[path] = GetGitLogs(path);
-        }
+    // Read before the walk, so that its whole history is walked even if HEAD
+    // moves meanwhile. Bounded walks leave out part of it.
+    git_oid head = {};
+    if (config_.range.empty() && config_.since.empty() && config_.max_count == 0) {
+        head = HeadOid();
     }
 
-    // Read and parse existing changelog.
-    std::string existing_raw = ReadChangelogFile(config_.output);
-    auto existing_sections = ParseChangelogStructured(existing_raw);
-    std::set<CommitEntry> existing_flat = FlattenEntries(existing_sections);
+    // Resident changelogs are whole in memory anyway, so only one-off writes
+    // are bounded.
+    spill_.reset();
+    if (config_.memory_limit > 0 && !retain) {
+        spill_ = std::make_unique<EntrySpill>(config_.memory_limit);
+    }
 
-    // Filter out already-recorded entries.
-    std::map<std::string, SectionData> new_sections;
-    for (auto& [name, data] : current_sections) {
-        SectionData filtered = FilterNewEntries(data, existing_flat);
-        if (!filtered.entries.empty()) {
-            new_sections[name] = std::move(filtered);
-        }
+    spdlog::debug("Getting logs for {} path(s){}", plan.paths.size(),
+                  plan.whole_repo ? " and the entire repository" : "");
+    std::vector<SectionData> walked =
+        GetGitLogs(plan.paths, hidden, cache, plan.whole_repo, releases);
+    if (spill_) {
+        spill_->Finish();
+        stats_.Add(Counter::kRunsSpilled, spill_->runs());
+    }
+
+    // Everything collected so far is alive at once from here on.
+    std::size_t live = 0;
+    for (const auto& data : walked) live += data.entries.size();
+    for (const auto& e : existing) live += e.recorded_size();
+    stats_.Max(Counter::kPeakEntries, live);
+
+    if (cache) {
+        auto timer = stats_.Time("save_cache");
+        cache->Save();
     }
 
     // Detect initial version from git tags.
     SemanticVersion seed = DetectInitialVersion();
 
+    // `walked` holds one group of sections per release, then the unreleased
+    // one, each laid out alike.
+    std::size_t width = walked.size() / (releases.size() + 1);
+    auto write_target = [&](std::size_t t) {
+        std::vector<SectionGroup> current(releases.size() + 1);
+        for (std::size_t g = 0; g < current.size(); ++g) {
+            const SectionData* group = &walked[g * width];
+            if (targets[t].follow.empty()) {
+                current[g][config_.repo_name] = &group[width - 1];
+            }
+            for (std::size_t i = 0; i < targets[t].follow.size(); ++i) {
+                current[g][targets[t].follow[i]] = &group[plan.index[t][i]];
+            }
+        }
+        WriteTarget(targets[t].output, existing[t], current, releases, seed, today,
+                    head, retain);
+    };
+
+    // Targets share nothing from here on, so they are rendered and written in
+    // parallel. The first failure is rethrown once every target is done.
+    // Every spilled target reads the spill through buffers of its own, so
+    // those are written one at a time to stay within the limit.
+    std::size_t threads = std::min<std::size_t>(
+        targets.size(), std::max(1u, std::thread::hardware_concurrency()));
+    if (spill_) threads = 1;
+    std::atomic<std::size_t> next_target{0};
+    std::mutex mu;
+    std::exception_ptr error;
+    auto writer = [&]() {
+        std::size_t t;
+        while ((t = next_target.fetch_add(1)) < targets.size()) {
+            try {
+                write_target(t);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mu);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+    std::vector<std::thread> writers;
+    for (std::size_t i = 1; i < threads; ++i) {
+        writers.emplace_back(writer);
+    }
+    writer();
+    for (auto& w : writers) {
+        w.join();
+    }
+    spill_.reset();
+    if (error) std::rethrow_exception(error);
+}
+
+void Changelog::WriteTarget(const std::string& output, ExistingChangelog& existing,
+                            const std::vector<SectionGroup>& current,
+                            const std::vector<Release>& releases,
+                            const SemanticVersion& seed, const std::string& today,
+                            const git_oid& head, bool retain) {
+    using VersionedSections = std::vector<std::pair<std::string, SectionData>>;
+    std::vector<ParsedSection>& existing_sections = existing.sections;
+
+    // Filter out already-recorded entries.
+    std::vector<std::map<std::string, SectionData>> new_groups(current.size());
+    {
+        auto timer = stats_.Time("filter");
+        for (std::size_t g = 0; g < current.size(); ++g) {
+            for (const auto& [name, data] : current[g]) {
+                SectionData filtered = FilterNewEntries(*data, existing);
+                std::size_t kept = filtered.size();
+                stats_.Add(Counter::kEntriesFiltered, data->size() - kept);
+                if (kept > 0) {
+                    new_groups[g][name] = std::move(filtered);
+                }
+            }
+        }
+    }
+    std::map<std::string, SectionData>& new_sections = new_groups.back();
+
+    // Released sections carry the version of their tag, newest release first.
+    std::vector<VersionedSections> released;
+    for (std::size_t r = releases.size(); r-- > 0;) {
+        auto& sections = released.emplace_back();
+        for (auto& [name, data] : new_groups[r]) {
+            sections.emplace_back(name + "@" + releases[r].version.ToString(),
+                                  std::move(data));
+        }
+    }
+
     // Determine the last version from existing sections.
     SemanticVersion last_version = seed;
     bool needs_backfill = false;
@@ -499,74 +2388,188 @@ void Changelog::Generate() {
         needs_backfill = true;
     }
 
-    // Backfill versions on old unversioned sections.
-    std::string existing_content;
+    // Assign the detected tag version to old unversioned sections. We can't
+    // accurately reconstruct per-section versions from changelog text alone,
+    // so they all get the tag version.
     if (needs_backfill) {
-        const auto& type_names = CommitTypeNames();
-        std::ostringstream oss;
-
-        // Assign the detected tag version to old unversioned sections.
-        // We can't accurately reconstruct per-section versions from
-        // changelog text alone, so they all get the tag version.
         for (auto& sec : existing_sections) {
             sec.version = seed;
         }
         last_version = seed;
-
-        // Re-format existing content with versions.
-        for (const auto& sec : existing_sections) {
-            oss << "## " << sec.name << "@" << sec.version->ToString() << " \u2014 "
-                << sec.date << "\n\n";
-            for (const auto& [type, logs] : sec.entries) {
-                if (logs.empty()) continue;
-                oss << "### " << type_names.at(type) << "\n\n";
-                for (const auto& log : logs) {
-                    oss << "- " << FormatEntry(log) << "\n";
-                }
-                oss << "\n";
-            }
-        }
-        existing_content = oss.str();
-    } else {
-        existing_content = existing_raw;
     }
 
     // Compute version for the new section(s).
     // If no existing sections, use the seed version directly (first release).
+    // Unreleased commits on top of releases follow on from the newest one.
     bool first_release = existing_sections.empty();
-    std::vector<std::pair<std::string, SectionData>> new_versioned;
+    if (!releases.empty()) {
+        last_version = releases.back().version;
+        first_release = false;
+    }
+    VersionedSections new_versioned;
     for (auto& [name, data] : new_sections) {
         SemanticVersion new_ver;
         if (first_release) {
             new_ver = seed;
             first_release = false;
         } else {
-            std::set<CommitType> types;
-            for (const auto& [type, _] : data.entries) {
-                types.insert(type);
-            }
-            new_ver = ComputeNextVersion(last_version, types, data.has_breaking_change);
+            new_ver = ComputeNextVersion(last_version, data.types(),
+                                         data.has_breaking_change);
         }
         std::string versioned_name = name + "@" + new_ver.ToString();
         new_versioned.emplace_back(versioned_name, std::move(data));
         last_version = new_ver;
     }
 
-    // Format and write.
-    std::string new_markdown = FormatChangelog(new_versioned, today);
+    bool any_released = false;
+    for (const auto& sections : released) any_released |= !sections.empty();
+
+    // A resident changelog with nothing to add is already what is on disk.
+    if (retain && new_versioned.empty() && !any_released && !needs_backfill) {
+        spdlog::debug("No new entries for {}", output);
+        return;
+    }
+
+    // Everything but an unchanged existing body is formatted into one buffer,
+    // which the body is written after without being copied. Spilled entries
+    // are streamed to the file instead, as they are formatted.
+    std::optional<AtomicFileWriter> file;
+    if (spill_) file.emplace(output);
+    AtomicFileWriter* stream = file ? &*file : nullptr;
+    fmt::memory_buffer out;
+    constexpr std::string_view kHeader = "# Changelog\n\n";
+    out.append(kHeader);
+    FormatChangelog(&out, new_versioned, today, existing, stream);
+    for (std::size_t i = 0; i < released.size(); ++i) {
+        FormatChangelog(&out, released[i], releases[releases.size() - 1 - i].date,
+                        existing, stream);
+    }
+    std::size_t new_end = out.size();
 
-    std::ofstream out(config_.output);
-    if (!out.is_open()) {
-        throw std::runtime_error("Cannot open output file: " + config_.output);
+    // A backfill only changes the section headers. They are formatted after
+    // the new sections, and spliced in between the unchanged stretches of
+    // the existing body, so entries are neither reformatted nor copied.
+    std::vector<std::size_t> header_ends;
+    if (needs_backfill) {
+        auto timer = stats_.Time("backfill");
+        for (const auto& sec : existing_sections) {
+            fmt::format_to(std::back_inserter(out), "## {}@{} \u2014 {}", sec.name,
+                           sec.version->ToString(), sec.date);
+            header_ends.push_back(out.size());
+        }
     }
 
-    out << "# Changelog\n\n";
-    if (!new_markdown.empty()) {
-        out << new_markdown;
+    // Where each section header ends up, for the index.
+    std::string_view formatted(out.data(), out.size());
+    std::vector<std::size_t> header_offsets;
+    FindSectionHeaders(formatted.substr(0, new_end), &header_offsets);
+
+    std::vector<std::string_view> parts = {formatted.substr(0, new_end)};
+    std::string_view rest = existing.body;
+    std::size_t written = new_end;
+    std::size_t header_begin = new_end;
+    for (std::size_t i = 0; i < existing_sections.size(); ++i) {
+        std::string_view old_header = existing_sections[i].header;
+        std::size_t old_begin = old_header.data() - rest.data();
+        header_offsets.push_back(written + old_begin);
+        if (!needs_backfill) continue;
+
+        std::string_view new_header =
+            formatted.substr(header_begin, header_ends[i] - header_begin);
+        parts.push_back(rest.substr(0, old_begin));
+        parts.push_back(new_header);
+        written += old_begin + new_header.size();
+        rest.remove_prefix(old_begin + old_header.size());
+        header_begin = header_ends[i];
+    }
+    parts.push_back(rest);
+    // Every line of the existing content is written newline-terminated.
+    if (!existing.body.empty() && existing.body.back() != '\n') {
+        parts.push_back("\n");
+    }
+    {
+        auto timer = stats_.Time("write");
+        if (file) {
+            file->Append(parts);
+            file->Commit();
+        } else {
+            WriteFileAtomic(output, parts);
+        }
     }
-    if (!existing_content.empty()) {
-        out << existing_content;
+    for (std::string_view part : parts) {
+        stats_.Add(Counter::kBytesWritten, part.size());
     }
 
-    spdlog::info("Wrote changelog to: {}", config_.output);
+    spdlog::info("Wrote changelog to: {}", output);
+
+    // Ties the companions, the index and the next update to the bytes just
+    // written, without reading them back.
+    bool write_index = config_.index && !spill_;
+    std::uint64_t checksum = 0;
+    if (config_.jsonl || config_.binary || write_index || retain) {
+        checksum = MarkdownChecksum(parts);
+    }
+
+    if (config_.jsonl || config_.binary) {
+        std::vector<DatedSections> groups = {{&new_versioned, today}};
+        for (std::size_t i = 0; i < released.size(); ++i) {
+            groups.push_back({&released[i], releases[releases.size() - 1 - i].date});
+        }
+        WriteFormats(output, checksum, groups, existing);
+    }
+
+    std::vector<git_oid> new_oids;
+    auto collect = [&](const VersionedSections& sections) {
+        for (const auto& [name, data] : sections) {
+            for (const auto& logs : data.entries.by_type) {
+                for (const auto& log : logs) new_oids.push_back(log.oid);
+            }
+        }
+    };
+    collect(new_versioned);
+    for (const auto& sections : released) collect(sections);
+
+    // The index would need every OID of the changelog in memory, and the
+    // offsets of headers already flushed, so a bounded write goes without.
+    if (spill_) {
+        std::remove(IndexPath(output).c_str());
+    } else if (write_index) {
+        auto timer = stats_.Time("write_index");
+        std::vector<git_oid> oids = new_oids;
+        oids.reserve(oids.size() + existing.recorded_size());
+        oids.insert(oids.end(), existing.recorded.begin(), existing.recorded.end());
+        for (std::size_t i = 0; i < existing.index.size(); ++i) {
+            oids.push_back(existing.index.oid(i));
+        }
+        // The newest section is either one just formatted or the first
+        // existing one, whose version a backfill has set.
+        std::optional<SemanticVersion> last_version;
+        if (!header_offsets.empty() && header_offsets.front() < new_end) {
+            ParsedSection newest;
+            std::string_view line = formatted.substr(header_offsets.front());
+            ParseHeaderLine(line.substr(0, line.find('\n')), &newest);
+            last_version = newest.version;
+        } else if (!existing_sections.empty()) {
+            last_version = existing_sections.front().version;
+        }
+        ChangelogIndex::Write(IndexPath(output), parts, checksum, std::move(oids),
+                              header_offsets, last_version, head);
+    }
+
+    if (!retain) return;
+
+    // Keep what was just written as the baseline of the next update, so it
+    // is neither reread nor reparsed. Only the section headers matter from
+    // now on: they decide the next version, and none needs a backfill.
+    std::string resident;
+    for (std::string_view part : parts) {
+        resident.append(part);
+    }
+    existing.recorded.insert(new_oids.begin(), new_oids.end());
+    existing.resident = std::move(resident);
+    existing.body = ChangelogBody(existing.resident);
+    existing.checksum = checksum;
+    existing.file = MappedFile();
+    existing.sections.clear();
+    ParseHeadersAt(existing.resident, header_offsets, &existing.sections);
 }
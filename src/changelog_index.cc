@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <spdlog/spdlog.h>
+
+#include "changelog_index.h"
+#include "utils.h"
+
+namespace {
+
+constexpr char kIndexMagic[8] = {'C', 'L', 'G', 'I', 'N', 'D', 'E', 'X'};
+// Bump whenever the layout changes, or the parser would read the markdown
+// differently.
+constexpr std::uint32_t kIndexFormatVersion = 1;
+
+constexpr std::uint32_t kFlagHasVersion = 1 << 0;
+
+int CompareOid(const unsigned char* a, const unsigned char* b) {
+    return std::memcmp(a, b, GIT_OID_SHA1_SIZE);
+}
+
+}  // namespace
+
+struct ChangelogIndex::Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    // Of the markdown the sidecar describes.
+    std::uint64_t content_size;
+    std::uint64_t checksum;
+    std::int32_t last_version[3];
+    unsigned char head[GIT_OID_SHA1_SIZE];
+    std::uint64_t header_count;
+    std::uint64_t oid_count;
+};
+
+ChangelogIndex::ChangelogIndex(const std::string& path, std::string_view content) {
+    // Keeps the header offsets that follow the header 8-byte aligned.
+    static_assert(sizeof(Header) % alignof(std::uint64_t) == 0);
+
+    file_ = MappedFile(path);
+    std::string_view data = file_.data();
+    if (data.empty()) {
+        spdlog::debug("No changelog index at {}", path);
+        return;
+    }
+
+    Header header = {};
+    bool valid = data.size() >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, data.data(), sizeof(header));
+        valid = std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+                header.version == kIndexFormatVersion &&
+                header.header_count <= data.size() / sizeof(std::uint64_t) &&
+                header.oid_count <= data.size() / GIT_OID_SHA1_SIZE;
+    }
+    std::size_t offsets_end =
+        sizeof(Header) + header.header_count * sizeof(std::uint64_t);
+    if (!valid || offsets_end + header.oid_count * GIT_OID_SHA1_SIZE != data.size()) {
+        spdlog::debug("Ignoring malformed changelog index at {}", path);
+        file_ = MappedFile();
+        return;
+    }
+
+    // The checksum goes last, as it is the only check that reads the whole
+    // markdown.
+    bool unchanged = header.content_size == content.size();
+    if (unchanged) {
+        Checksum checksum;
+        checksum.Add(content);
+        unchanged = checksum.Finish() == header.checksum;
+    }
+    if (!unchanged) {
+        spdlog::debug("Ignoring changelog index at {} of a changed changelog", path);
+        file_ = MappedFile();
+        return;
+    }
+
+    for (std::uint64_t i = 0; i < header.header_count; ++i) {
+        std::uint64_t offset;
+        std::memcpy(&offset, data.data() + sizeof(Header) + i * sizeof(offset),
+                    sizeof(offset));
+        if (offset >= content.size()) {
+            spdlog::debug("Ignoring changelog index at {} with a bad offset", path);
+            file_ = MappedFile();
+            header_offsets_.clear();
+            return;
+        }
+        header_offsets_.push_back(static_cast<std::size_t>(offset));
+    }
+    if (header.flags & kFlagHasVersion) {
+        last_version_ = SemanticVersion{header.last_version[0], header.last_version[1],
+                                        header.last_version[2]};
+    }
+    std::memcpy(head_.id, header.head, sizeof(header.head));
+    checksum_ = header.checksum;
+    oids_ = reinterpret_cast<const unsigned char*>(data.data() + offsets_end);
+    oid_count_ = header.oid_count;
+    valid_ = true;
+    spdlog::debug("Loaded {} recorded commits from {}", oid_count_, path);
+}
+
+bool ChangelogIndex::Contains(const git_oid& oid) const {
+    std::size_t lo = 0;
+    std::size_t hi = oid_count_;
+    while (lo < hi) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        int cmp = CompareOid(oids_ + mid * GIT_OID_SHA1_SIZE, oid.id);
+        if (cmp == 0) return true;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+git_oid ChangelogIndex::oid(std::size_t i) const {
+    git_oid oid;
+    std::memcpy(oid.id, oids_ + i * GIT_OID_SHA1_SIZE, GIT_OID_SHA1_SIZE);
+    return oid;
+}
+
+void ChangelogIndex::Write(const std::string& path,
+                           const std::vector<std::string_view>& parts,
+                           std::uint64_t checksum, std::vector<git_oid> oids,
+                           const std::vector<std::size_t>& header_offsets,
+                           const std::optional<SemanticVersion>& last_version,
+                           const git_oid& head) {
+    auto less = [](const git_oid& a, const git_oid& b) {
+        return CompareOid(a.id, b.id) < 0;
+    };
+    auto equal = [](const git_oid& a, const git_oid& b) {
+        return CompareOid(a.id, b.id) == 0;
+    };
+    std::sort(oids.begin(), oids.end(), less);
+    oids.erase(std::unique(oids.begin(), oids.end(), equal), oids.end());
+
+    Header header = {};
+    std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexFormatVersion;
+    for (std::string_view part : parts) {
+        header.content_size += part.size();
+    }
+    header.checksum = checksum;
+    if (last_version) {
+        header.flags |= kFlagHasVersion;
+        header.last_version[0] = last_version->major;
+        header.last_version[1] = last_version->minor;
+        header.last_version[2] = last_version->patch;
+    }
+    std::memcpy(header.head, head.id, sizeof(header.head));
+    header.header_count = header_offsets.size();
+    header.oid_count = oids.size();
+
+    // The OIDs are written as they are, one packed 20-byte array.
+    static_assert(sizeof(git_oid) == GIT_OID_SHA1_SIZE);
+    std::vector<std::uint64_t> offsets(header_offsets.begin(), header_offsets.end());
+
+    try {
+        WriteFileAtomic(path, {{reinterpret_cast<const char*>(&header), sizeof(header)},
+                               {reinterpret_cast<const char*>(offsets.data()),
+                                offsets.size() * sizeof(std::uint64_t)},
+                               {reinterpret_cast<const char*>(oids.data()),
+                                oids.size() * sizeof(git_oid)}});
+    } catch (const std::exception& err) {
+        spdlog::warn("Failed to save changelog index: {}", err.what());
+        return;
+    }
+    spdlog::debug("Saved {} recorded commits to {}", oids.size(), path);
+}
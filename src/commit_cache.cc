@@ -0,0 +1,310 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+#include "commit_cache.h"
+#include "utils.h"
+
+namespace {
+
+constexpr char kCacheMagic[8] = {'C', 'L', 'G', 'C', 'A', 'C', 'H', 'E'};
+// Bump whenever the record layout or the classification rules change.
+constexpr std::uint32_t kCacheFormatVersion = 1;
+
+constexpr std::uint8_t kFlagBreaking = 1 << 0;
+constexpr std::uint8_t kKnownFlags = kFlagBreaking;
+
+std::size_t WordsPerRecord(std::uint32_t path_count) { return (path_count + 63) / 64; }
+
+// FNV-1a over everything the cached results depend on.
+class KeyHasher {
+   public:
+    void Add(const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+    // Strings are hashed with their terminator so that adjacent ones can't
+    // run together.
+    void Add(std::string_view str) {
+        Add(str.data(), str.size());
+        Add("", 1);
+    }
+
+    std::uint64_t hash() const { return hash_; }
+
+   private:
+    std::uint64_t hash_ = 14695981039346656037ull;
+};
+
+std::uint64_t CacheKey(const std::vector<std::string>& follow) {
+    KeyHasher h;
+    h.Add(&kCacheFormatVersion, sizeof(kCacheFormatVersion));
+    std::uint64_t path_count = follow.size();
+    h.Add(&path_count, sizeof(path_count));
+    for (const auto& path : follow) {
+        h.Add(path);
+    }
+    for (const auto& spec : kCommitTypeSpecs) {
+        h.Add(spec.prefix);
+        auto value = static_cast<std::int32_t>(spec.type);
+        h.Add(&value, sizeof(value));
+    }
+    return h.hash();
+}
+
+int CompareOid(const unsigned char* a, const unsigned char* b) {
+    return std::memcmp(a, b, GIT_OID_SHA1_SIZE);
+}
+
+}  // namespace
+
+struct CommitCache::Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t path_count;
+    std::uint64_t key;
+    std::uint64_t record_count;
+    std::uint64_t strings_size;
+};
+
+struct CommitCache::Record {
+    unsigned char oid[GIT_OID_SHA1_SIZE];
+    // 0 when uncategorized, CommitType + 1 otherwise.
+    std::uint8_t type;
+    std::uint8_t flags;
+    std::uint16_t reserved;
+    std::uint32_t summary_offset;
+    std::uint32_t summary_size;
+    std::uint32_t author_offset;
+    std::uint32_t author_size;
+};
+
+CommitCache::CommitCache(std::string path, const std::vector<std::string>& follow)
+    : path_(std::move(path)),
+      key_(CacheKey(follow)),
+      path_count_(static_cast<std::uint32_t>(follow.size())) {
+    Map();
+}
+
+CommitCache::~CommitCache() = default;
+
+void CommitCache::Map() {
+    // Keeps the bitmap words that follow the records 8-byte aligned.
+    static_assert(sizeof(Header) % alignof(std::uint64_t) == 0);
+    static_assert(sizeof(Record) % alignof(std::uint64_t) == 0);
+
+    file_ = MappedFile(path_);
+    std::string_view data = file_.data();
+    if (data.empty()) {
+        spdlog::debug("No commit cache at {}", path_);
+        return;
+    }
+
+    Header header = {};
+    bool valid = data.size() >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, data.data(), sizeof(header));
+        valid = std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) == 0 &&
+                header.version == kCacheFormatVersion && header.key == key_ &&
+                header.path_count == path_count_ &&
+                header.record_count <= data.size() / sizeof(Record) &&
+                header.strings_size <= data.size();
+    }
+
+    std::size_t words = WordsPerRecord(path_count_);
+    std::size_t records_end = sizeof(Header) + header.record_count * sizeof(Record);
+    std::size_t words_end =
+        records_end + header.record_count * words * sizeof(std::uint64_t);
+    if (!valid || words_end + header.strings_size != data.size()) {
+        spdlog::debug("Ignoring stale commit cache at {}", path_);
+        Unmap();
+        return;
+    }
+
+    records_ = reinterpret_cast<const Record*>(data.data() + sizeof(Header));
+    record_count_ = header.record_count;
+    touch_words_ = reinterpret_cast<const std::uint64_t*>(data.data() + records_end);
+    strings_ = data.data() + words_end;
+    strings_size_ = header.strings_size;
+    spdlog::debug("Loaded {} cached commits from {}", record_count_, path_);
+}
+
+void CommitCache::Unmap() {
+    file_ = MappedFile();
+    records_ = nullptr;
+    record_count_ = 0;
+    touch_words_ = nullptr;
+    strings_ = nullptr;
+    strings_size_ = 0;
+}
+
+bool CommitCache::ValidRecord(const Record& r) const {
+    // A damaged or foreign file must read as a miss: the type indexes
+    // per-type arrays, and the strings must lie within the blob.
+    return r.type <= kCommitTypeCount && (r.flags & ~kKnownFlags) == 0 &&
+           std::size_t(r.summary_offset) + r.summary_size <= strings_size_ &&
+           std::size_t(r.author_offset) + r.author_size <= strings_size_;
+}
+
+std::vector<bool> CommitCache::MappedTouches(std::size_t index) const {
+    std::vector<bool> touches(path_count_);
+    const std::uint64_t* words = touch_words_ + index * WordsPerRecord(path_count_);
+    for (std::uint32_t i = 0; i < path_count_; ++i) {
+        touches[i] = (words[i / 64] >> (i % 64)) & 1;
+    }
+    return touches;
+}
+
+bool CommitCache::Lookup(const git_oid& oid, CommitInfo* out) const {
+    const Record* end = records_ + record_count_;
+    const Record* it =
+        std::lower_bound(records_, end, oid, [](const Record& r, const git_oid& o) {
+            return CompareOid(r.oid, o.id) < 0;
+        });
+    if (it == end || CompareOid(it->oid, oid.id) != 0) {
+        return false;
+    }
+
+    if (!ValidRecord(*it)) return false;
+
+    out->type = it->type ? std::optional(static_cast<CommitType>(it->type - 1))
+                         : std::nullopt;
+    out->breaking = it->flags & kFlagBreaking;
+    out->summary.assign(strings_ + it->summary_offset, it->summary_size);
+    out->author_name.assign(strings_ + it->author_offset, it->author_size);
+    out->touches = MappedTouches(static_cast<std::size_t>(it - records_));
+    return true;
+}
+
+void CommitCache::Insert(const git_oid& oid, const CommitInfo& info) {
+    pending_.emplace_back(oid, info);
+}
+
+void CommitCache::Save() {
+    if (pending_.empty()) return;
+
+    std::sort(pending_.begin(), pending_.end(), [](const auto& a, const auto& b) {
+        return CompareOid(a.first.id, b.first.id) < 0;
+    });
+    // A commit inserted again after a failed save is only written once.
+    pending_.erase(std::unique(pending_.begin(), pending_.end(),
+                               [](const auto& a, const auto& b) {
+                                   return CompareOid(a.first.id, b.first.id) == 0;
+                               }),
+                   pending_.end());
+
+    // Pack the bitmaps of new commits so both sources can be copied alike.
+    const std::size_t words = WordsPerRecord(path_count_);
+    std::vector<std::uint64_t> pending_words(pending_.size() * words);
+    for (std::size_t p = 0; p < pending_.size(); ++p) {
+        const auto& touches = pending_[p].second.touches;
+        for (std::size_t i = 0; i < touches.size() && i < path_count_; ++i) {
+            if (touches[i]) pending_words[p * words + i / 64] |= 1ull << (i % 64);
+        }
+    }
+
+    struct Row {
+        const unsigned char* oid;
+        std::uint8_t type;
+        std::uint8_t flags;
+        std::string_view summary;
+        std::string_view author_name;
+        const std::uint64_t* words;
+    };
+
+    auto mapped_row = [&](std::size_t i) {
+        const Record& r = records_[i];
+        return Row{r.oid,
+                   r.type,
+                   r.flags,
+                   {strings_ + r.summary_offset, r.summary_size},
+                   {strings_ + r.author_offset, r.author_size},
+                   touch_words_ + i * words};
+    };
+    auto pending_row = [&](std::size_t p) {
+        const auto& [oid, info] = pending_[p];
+        return Row{oid.id,
+                   static_cast<std::uint8_t>(
+                       info.type ? static_cast<std::uint8_t>(*info.type) + 1 : 0),
+                   static_cast<std::uint8_t>(info.breaking ? kFlagBreaking : 0),
+                   info.summary,
+                   info.author_name,
+                   pending_words.data() + p * words};
+    };
+
+    // Merge the mapped and pending tables, both sorted by OID.
+    std::vector<Row> rows;
+    rows.reserve(record_count_ + pending_.size());
+    std::size_t m = 0, p = 0;
+    while (m < record_count_ || p < pending_.size()) {
+        // Records Lookup() would reject are dropped rather than copied.
+        if (m < record_count_ && !ValidRecord(records_[m])) {
+            ++m;
+        } else if (p == pending_.size()) {
+            rows.push_back(mapped_row(m++));
+        } else if (m == record_count_) {
+            rows.push_back(pending_row(p++));
+        } else {
+            int cmp = CompareOid(records_[m].oid, pending_[p].first.id);
+            if (cmp < 0) {
+                rows.push_back(mapped_row(m++));
+            } else {
+                if (cmp == 0) ++m;
+                rows.push_back(pending_row(p++));
+            }
+        }
+    }
+
+    // Authors repeat across most commits, so store each name once.
+    std::string strings;
+    std::unordered_map<std::string_view, std::uint32_t> author_offsets;
+    std::vector<Record> records(rows.size());
+    std::vector<std::uint64_t> touch_words(rows.size() * words);
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        const Row& row = rows[i];
+        Record& r = records[i];
+        std::memcpy(r.oid, row.oid, sizeof(r.oid));
+        r.type = row.type;
+        r.flags = row.flags;
+        r.reserved = 0;
+        r.summary_offset = static_cast<std::uint32_t>(strings.size());
+        r.summary_size = static_cast<std::uint32_t>(row.summary.size());
+        strings.append(row.summary);
+        auto [it, inserted] = author_offsets.try_emplace(
+            row.author_name, static_cast<std::uint32_t>(strings.size()));
+        if (inserted) strings.append(row.author_name);
+        r.author_offset = it->second;
+        r.author_size = static_cast<std::uint32_t>(row.author_name.size());
+        std::copy(row.words, row.words + words, touch_words.begin() + i * words);
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheFormatVersion;
+    header.path_count = path_count_;
+    header.key = key_;
+    header.record_count = records.size();
+    header.strings_size = strings.size();
+
+    try {
+        WriteFileAtomic(
+            path_, {{reinterpret_cast<const char*>(&header), sizeof(header)},
+                    {reinterpret_cast<const char*>(records.data()),
+                     records.size() * sizeof(Record)},
+                    {reinterpret_cast<const char*>(touch_words.data()),
+                     touch_words.size() * sizeof(std::uint64_t)},
+                    strings});
+    } catch (const std::exception& err) {
+        spdlog::warn("Failed to save commit cache: {}", err.what());
+        return;
+    }
+    spdlog::debug("Saved {} commits to cache {}", records.size(), path_);
+    pending_.clear();
+    Map();
+}
@@ -0,0 +1,292 @@
+#include <cstring>
+#include <sstream>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#include "commit_graph.h"
+#include "utils.h"
+
+namespace {
+
+constexpr std::size_t kHeaderSize = 8;
+constexpr std::size_t kChunkEntrySize = 12;
+constexpr std::size_t kFanoutSize = 256 * 4;
+constexpr std::size_t kBloomHeaderSize = 12;
+
+// Seeds git uses for the two halves of its double hashing.
+constexpr std::uint32_t kBloomSeed0 = 0x293ae76f;
+constexpr std::uint32_t kBloomSeed1 = 0x7e646e2c;
+
+std::uint32_t RotateLeft(std::uint32_t value, int count) {
+    return (value << count) | (value >> (32 - count));
+}
+
+// Widens one byte of a hashed path. Version 1 filters were computed with
+// `char` being signed, which sign-extends bytes from 0x80 up; version 2 fixed
+// that, and both are still found in the wild.
+std::uint32_t HashByte(char c, std::uint32_t hash_version) {
+    if (hash_version == 1) {
+        return static_cast<std::uint32_t>(static_cast<signed char>(c));
+    }
+    return static_cast<unsigned char>(c);
+}
+
+// 32-bit MurmurHash3, exactly as git's bloom.c computes it.
+std::uint32_t Murmur3(std::uint32_t seed, std::string_view data,
+                      std::uint32_t hash_version) {
+    constexpr std::uint32_t c1 = 0xcc9e2d51;
+    constexpr std::uint32_t c2 = 0x1b873593;
+
+    std::uint32_t h = seed;
+    std::size_t blocks = data.size() / 4;
+    for (std::size_t i = 0; i < blocks; ++i) {
+        const char* b = data.data() + 4 * i;
+        std::uint32_t k = HashByte(b[0], hash_version) |
+                          HashByte(b[1], hash_version) << 8 |
+                          HashByte(b[2], hash_version) << 16 |
+                          HashByte(b[3], hash_version) << 24;
+        k *= c1;
+        k = RotateLeft(k, 15);
+        k *= c2;
+        h ^= k;
+        h = RotateLeft(h, 13) * 5 + 0xe6546b64;
+    }
+
+    const char* tail = data.data() + 4 * blocks;
+    std::uint32_t k = 0;
+    switch (data.size() & 3) {
+        case 3:
+            k ^= HashByte(tail[2], hash_version) << 16;
+            [[fallthrough]];
+        case 2:
+            k ^= HashByte(tail[1], hash_version) << 8;
+            [[fallthrough]];
+        case 1:
+            k ^= HashByte(tail[0], hash_version);
+            k *= c1;
+            k = RotateLeft(k, 15);
+            k *= c2;
+            h ^= k;
+    }
+
+    h ^= static_cast<std::uint32_t>(data.size());
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+struct Chunk {
+    const unsigned char* data = nullptr;
+    std::size_t size = 0;
+};
+
+}  // namespace
+
+struct CommitGraph::Layer {
+    MappedFile file;
+    // 256 cumulative commit counts by first OID byte, then the sorted OIDs.
+    const unsigned char* fanout = nullptr;
+    const unsigned char* oids = nullptr;
+    std::uint32_t count = 0;
+    // Cumulative end offset of each commit's filter in `bloom_data`; null
+    // when the layer has no usable filters.
+    const unsigned char* bloom_index = nullptr;
+    const unsigned char* bloom_data = nullptr;
+    std::size_t bloom_size = 0;
+
+    // Position of `oid` in this layer.
+    std::optional<std::uint32_t> Find(const git_oid& oid) const {
+        unsigned char first = oid.id[0];
+        std::uint32_t lo = first == 0 ? 0 : ReadBigEndian32(fanout + 4 * (first - 1));
+        std::uint32_t hi = ReadBigEndian32(fanout + 4 * first);
+        if (hi > count) return std::nullopt;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(oids + std::size_t{mid} * GIT_OID_SHA1_SIZE, oid.id,
+                                  GIT_OID_SHA1_SIZE);
+            if (cmp == 0) return mid;
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+CommitGraph::CommitGraph() = default;
+CommitGraph::~CommitGraph() = default;
+
+std::unique_ptr<CommitGraph> CommitGraph::Open(const std::string& objects_dir,
+                                               bool read_changed_paths) {
+    std::unique_ptr<CommitGraph> graph(new CommitGraph());
+    graph->read_changed_paths_ = read_changed_paths;
+    // Like git, prefer a single graph file over a chain next to it.
+    if (graph->AddLayer(objects_dir + "/info/commit-graph")) {
+        return graph;
+    }
+
+    // A chain lists its layers base first, one file hash per line. A broken
+    // layer leaves the ones below it usable.
+    std::string chain_dir = objects_dir + "/info/commit-graphs/";
+    MappedFile chain(chain_dir + "commit-graph-chain");
+    std::istringstream lines{std::string(chain.data())};
+    std::string hash;
+    while (std::getline(lines, hash)) {
+        if (!graph->AddLayer(chain_dir + "graph-" + hash + ".graph")) break;
+    }
+    if (graph->layers_.empty()) return nullptr;
+    return graph;
+}
+
+bool CommitGraph::AddLayer(const std::string& path) {
+    Layer layer;
+    layer.file = MappedFile(path);
+    std::string_view data = layer.file.data();
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+
+    // Header: signature, format version 1, SHA-1 OIDs, chunk count and the
+    // number of layers below this one.
+    if (data.size() < kHeaderSize + GIT_OID_SHA1_SIZE ||
+        std::memcmp(bytes, "CGPH", 4) != 0 || bytes[4] != 1 || bytes[5] != 1 ||
+        bytes[7] != layers_.size()) {
+        if (!data.empty()) spdlog::debug("Ignoring unsupported commit-graph {}", path);
+        return false;
+    }
+
+    // The chunk table ends with an entry whose offset marks the end of the
+    // last chunk; the file ends with its checksum.
+    std::size_t chunk_count = bytes[6];
+    std::size_t table_end = kHeaderSize + (chunk_count + 1) * kChunkEntrySize;
+    std::size_t chunks_end = data.size() - GIT_OID_SHA1_SIZE;
+    if (table_end > chunks_end) {
+        spdlog::debug("Ignoring truncated commit-graph {}", path);
+        return false;
+    }
+
+    Chunk oid_fanout, oid_lookup, bloom_index, bloom_data;
+    for (std::size_t i = 0; i < chunk_count; ++i) {
+        const unsigned char* entry = bytes + kHeaderSize + i * kChunkEntrySize;
+        std::uint64_t begin = ReadBigEndian64(entry + 4);
+        std::uint64_t end = ReadBigEndian64(entry + kChunkEntrySize + 4);
+        if (begin < table_end || end < begin || end > chunks_end) {
+            spdlog::debug("Ignoring commit-graph {} with a corrupt chunk table", path);
+            return false;
+        }
+
+        Chunk chunk = {bytes + begin, static_cast<std::size_t>(end - begin)};
+        std::string_view id(reinterpret_cast<const char*>(entry), 4);
+        if (id == "OIDF") {
+            oid_fanout = chunk;
+        } else if (id == "OIDL") {
+            oid_lookup = chunk;
+        } else if (id == "BIDX") {
+            bloom_index = chunk;
+        } else if (id == "BDAT") {
+            bloom_data = chunk;
+        }
+    }
+
+    if (oid_fanout.size != kFanoutSize) {
+        spdlog::debug("Ignoring commit-graph {} without an OID fanout", path);
+        return false;
+    }
+    layer.fanout = oid_fanout.data;
+    layer.count = ReadBigEndian32(oid_fanout.data + kFanoutSize - 4);
+    if (oid_lookup.size != std::size_t{layer.count} * GIT_OID_SHA1_SIZE) {
+        spdlog::debug("Ignoring commit-graph {} with a short OID lookup", path);
+        return false;
+    }
+    layer.oids = oid_lookup.data;
+
+    if (read_changed_paths_ && bloom_index.size == std::size_t{layer.count} * 4 &&
+        bloom_data.size >= kBloomHeaderSize) {
+        std::uint32_t hash_version = ReadBigEndian32(bloom_data.data);
+        std::uint32_t num_hashes = ReadBigEndian32(bloom_data.data + 4);
+        if (num_hashes_ == 0 && (hash_version == 1 || hash_version == 2) &&
+            num_hashes > 0) {
+            hash_version_ = hash_version;
+            num_hashes_ = num_hashes;
+        }
+        if (hash_version == hash_version_ && num_hashes == num_hashes_) {
+            layer.bloom_index = bloom_index.data;
+            layer.bloom_data = bloom_data.data + kBloomHeaderSize;
+            layer.bloom_size = bloom_data.size - kBloomHeaderSize;
+        } else {
+            spdlog::debug("Ignoring Bloom filters of {} with different settings", path);
+        }
+    }
+
+    spdlog::debug("Loaded {} commits from {}{}", layer.count, path,
+                  layer.bloom_index ? " with changed-path filters" : "");
+    layers_.push_back(std::move(layer));
+    return true;
+}
+
+std::optional<CommitGraph::PathKey> CommitGraph::MakeKey(
+    const std::string& path) const {
+    if (!has_bloom_filters()) return std::nullopt;
+
+    std::string_view literal = path;
+    while (!literal.empty() && literal.back() == '/') literal.remove_suffix(1);
+    if (literal.empty()) return std::nullopt;
+
+    // Filters hold every leading directory of a changed path too, so each of
+    // them has to be present as well.
+    PathKey key;
+    std::size_t start = 0;
+    while (true) {
+        std::size_t slash = literal.find('/', start);
+        std::string_view component = literal.substr(start, slash - start);
+        if (component.empty() || component == "." || component == "..") {
+            return std::nullopt;
+        }
+
+        std::string_view prefix = literal.substr(0, slash);
+        std::uint32_t h0 = Murmur3(kBloomSeed0, prefix, hash_version_);
+        std::uint32_t h1 = Murmur3(kBloomSeed1, prefix, hash_version_);
+        for (std::uint32_t i = 0; i < num_hashes_; ++i) {
+            key.hashes.push_back(h0 + i * h1);
+        }
+
+        if (slash == std::string_view::npos) break;
+        start = slash + 1;
+    }
+    return key;
+}
+
+CommitGraph::Filter CommitGraph::FilterFor(const git_oid& oid) const {
+    Filter filter;
+    for (const Layer& layer : layers_) {
+        std::optional<std::uint32_t> pos = layer.Find(oid);
+        if (!pos) continue;
+        if (!layer.bloom_index) break;
+
+        const unsigned char* index = layer.bloom_index + 4 * std::size_t{*pos};
+        std::uint32_t end = ReadBigEndian32(index);
+        std::uint32_t begin = *pos == 0 ? 0 : ReadBigEndian32(index - 4);
+        if (begin <= end && end <= layer.bloom_size) {
+            filter.data_ = layer.bloom_data + begin;
+            filter.size_ = end - begin;
+        }
+        break;
+    }
+    return filter;
+}
+
+bool CommitGraph::Filter::MayContain(const PathKey& key) const {
+    // Git leaves the filter empty when it could not compute one.
+    if (size_ == 0) return true;
+
+    std::uint64_t bits = std::uint64_t{size_} * 8;
+    for (std::uint32_t hash : key.hashes) {
+        std::uint64_t bit = hash % bits;
+        if (!(data_[bit / 8] & (1u << (bit % 8)))) return false;
+    }
+    return true;
+}
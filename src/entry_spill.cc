@@ -0,0 +1,328 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+
+#include "entry_spill.h"
+
+namespace {
+
+// Writes to and reads from the file go through buffers of this size.
+constexpr std::size_t kIoBufferSize = 64 * 1024;
+// Read buffers don't shrink below this, however many runs share a merge.
+constexpr std::size_t kMinReadBufferSize = 4 * 1024;
+
+// A spilled entry: the two string sizes and the OID, then the strings.
+constexpr std::size_t kEntryHeaderSize = 2 * sizeof(std::uint32_t) + GIT_OID_SHA1_SIZE;
+
+[[noreturn]] void ThrowErrno(const std::string& msg) {
+    throw std::runtime_error(msg + ": " + std::strerror(errno));
+}
+
+// An entry being merged, viewed in the buffer of the source it came from.
+struct MergeHead {
+    std::string_view summary;
+    git_oid oid;
+    std::string_view author_name;
+    std::size_t source;
+};
+
+// Appends one entry in its spilled form to `out`.
+void AppendEntry(std::string* out, std::string_view summary, const git_oid& oid,
+                 std::string_view author_name) {
+    auto summary_size = static_cast<std::uint32_t>(summary.size());
+    auto author_size = static_cast<std::uint32_t>(author_name.size());
+    char header[kEntryHeaderSize];
+    std::memcpy(header, &summary_size, sizeof(summary_size));
+    std::memcpy(header + sizeof(summary_size), &author_size, sizeof(author_size));
+    std::memcpy(header + 2 * sizeof(std::uint32_t), oid.id, GIT_OID_SHA1_SIZE);
+    out->append(header, sizeof(header));
+    out->append(summary);
+    out->append(author_name);
+}
+
+// Orders heads like CommitEntry::operator<, smallest on top of the heap.
+struct MergeHeadGreater {
+    bool operator()(const MergeHead& a, const MergeHead& b) const {
+        int cmp = a.summary.compare(b.summary);
+        return cmp != 0 ? cmp > 0 : git_oid_cmp(&a.oid, &b.oid) > 0;
+    }
+};
+
+}  // namespace
+
+struct EntrySpill::Record {
+    std::uint32_t section;
+    std::uint32_t type;
+    // Offset of the summary in text_, followed by the author name.
+    std::uint64_t text;
+    std::uint32_t summary_size;
+    std::uint32_t author_size;
+    git_oid oid;
+};
+
+// Reads the entries of one extent of the file in order.
+class EntrySpill::RunReader {
+   public:
+    RunReader(int fd, const Extent& extent, std::size_t buffer_size)
+        : fd_(fd), next_(extent.begin), end_(extent.end) {
+        buffer_.resize(buffer_size);
+    }
+
+    // Moves on to the next entry. Returns false at the end of the extent.
+    bool Next(MergeHead* head) {
+        if (!Fill(kEntryHeaderSize)) return false;
+        const char* p = buffer_.data() + pos_;
+        std::uint32_t summary_size;
+        std::uint32_t author_size;
+        std::memcpy(&summary_size, p, sizeof(summary_size));
+        std::memcpy(&author_size, p + sizeof(summary_size), sizeof(author_size));
+        std::size_t size = kEntryHeaderSize + summary_size + author_size;
+        if (!Fill(size)) {
+            throw std::runtime_error("Truncated entry in the spill file");
+        }
+
+        p = buffer_.data() + pos_;
+        std::memcpy(head->oid.id, p + 2 * sizeof(std::uint32_t), GIT_OID_SHA1_SIZE);
+        head->summary = {p + kEntryHeaderSize, summary_size};
+        head->author_name = {p + kEntryHeaderSize + summary_size, author_size};
+        pos_ += size;
+        return true;
+    }
+
+   private:
+    // Makes at least `size` unread bytes available, unless the extent ends
+    // first. Moves what is left to the front, which invalidates earlier
+    // views.
+    bool Fill(std::size_t size) {
+        std::size_t left = len_ - pos_;
+        if (left >= size) return true;
+        if (left + (end_ - next_) < size) return false;
+
+        std::memmove(buffer_.data(), buffer_.data() + pos_, left);
+        pos_ = 0;
+        len_ = left;
+        if (buffer_.size() < size) buffer_.resize(size);
+        std::size_t want = std::min<std::uint64_t>(buffer_.size() - len_, end_ - next_);
+        while (want > 0) {
+            ssize_t got = pread(fd_, buffer_.data() + len_, want, next_);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                ThrowErrno("Cannot read the spill file");
+            }
+            if (got == 0) break;
+            len_ += static_cast<std::size_t>(got);
+            next_ += static_cast<std::uint64_t>(got);
+            want -= static_cast<std::size_t>(got);
+        }
+        return len_ >= size;
+    }
+
+    int fd_;
+    std::uint64_t next_;
+    std::uint64_t end_;
+    std::vector<char> buffer_;
+    std::size_t pos_ = 0;
+    std::size_t len_ = 0;
+};
+
+EntrySpill::EntrySpill(std::size_t memory_limit) : memory_limit_(memory_limit) {}
+
+EntrySpill::~EntrySpill() {
+    if (fd_ >= 0) close(fd_);
+}
+
+std::size_t EntrySpill::BufferedBytes() const {
+    return records_.size() * sizeof(Record) + text_.size();
+}
+
+void EntrySpill::Add(std::size_t section, CommitType type, std::string_view summary,
+                     const git_oid& oid, std::string_view author_name) {
+    Record record;
+    record.section = static_cast<std::uint32_t>(section);
+    record.type = static_cast<std::uint32_t>(CommitTypeIndex(type));
+    record.text = text_.size();
+    record.summary_size = static_cast<std::uint32_t>(summary.size());
+    record.author_size = static_cast<std::uint32_t>(author_name.size());
+    record.oid = oid;
+    records_.push_back(record);
+    text_.append(summary);
+    text_.append(author_name);
+
+    // The buffer's vectors may take up to twice what they hold while they
+    // grow, so only half of the limit is filled before a run is spilled.
+    if (BufferedBytes() >= memory_limit_ / 2) Spill();
+}
+
+void EntrySpill::Finish() {
+    // Once anything is on disk, so is the rest, and every section's type is
+    // merged down to a single extent here. Each write of it then only reads
+    // that extent front to back, however many times it is visited.
+    if (runs_ == 0) {
+        SortBuffer();
+        finished_ = true;
+        return;
+    }
+    if (!records_.empty()) Spill();
+
+    // Merges get a quarter of the limit for their read buffers. Beyond as
+    // many runs as fit in it at the smallest buffer size, groups of runs are
+    // merged into larger ones first.
+    std::size_t fan_in =
+        std::max<std::size_t>(2, memory_limit_ / 4 / kMinReadBufferSize);
+    for (auto& extents : extents_) {
+        while (extents.size() > 1) {
+            std::vector<Extent> merged;
+            for (std::size_t i = 0; i < extents.size(); i += fan_in) {
+                std::size_t count = std::min(fan_in, extents.size() - i);
+                merged.push_back(count == 1 ? extents[i] : Merge(&extents[i], count));
+            }
+            extents = std::move(merged);
+        }
+    }
+    finished_ = true;
+}
+
+void EntrySpill::SortBuffer() {
+    std::sort(records_.begin(), records_.end(), [&](const Record& a, const Record& b) {
+        if (a.section != b.section) return a.section < b.section;
+        if (a.type != b.type) return a.type < b.type;
+        int cmp = std::string_view(text_.data() + a.text, a.summary_size)
+                      .compare(std::string_view(text_.data() + b.text, b.summary_size));
+        return cmp != 0 ? cmp < 0 : git_oid_cmp(&a.oid, &b.oid) < 0;
+    });
+}
+
+void EntrySpill::Spill() {
+    if (fd_ < 0) {
+        std::error_code ec;
+        std::filesystem::path dir = std::filesystem::temp_directory_path(ec);
+        if (ec) dir = "/tmp";
+        std::string path = (dir / "changelog-spill-XXXXXX").string();
+        fd_ = mkstemp(path.data());
+        if (fd_ < 0) {
+            ThrowErrno("Cannot create spill file in " + path);
+        }
+        // Nothing else needs the name, and an unlinked file goes away
+        // however the run ends.
+        unlink(path.c_str());
+    }
+
+    SortBuffer();
+
+    std::string out;
+    out.reserve(kIoBufferSize);
+    // Records of one section's type are contiguous after the sort, and each
+    // such stretch becomes one extent of this run.
+    std::size_t last_key = SIZE_MAX;
+    for (const Record& record : records_) {
+        std::size_t key = std::size_t{record.section} * kCommitTypeCount + record.type;
+        std::uint64_t offset = file_size_ + out.size();
+        if (key != last_key) {
+            if (last_key != SIZE_MAX) extents_[last_key].back().end = offset;
+            if (extents_.size() <= key) extents_.resize(key + 1);
+            extents_[key].push_back({offset, offset});
+            last_key = key;
+        }
+
+        const char* text = text_.data() + record.text;
+        AppendEntry(&out, {text, record.summary_size}, record.oid,
+                    {text + record.summary_size, record.author_size});
+        if (out.size() >= kIoBufferSize) Write(&out);
+    }
+    if (last_key != SIZE_MAX) extents_[last_key].back().end = file_size_ + out.size();
+    Write(&out);
+
+    ++runs_;
+    records_.clear();
+    text_.clear();
+}
+
+void EntrySpill::Write(std::string* out) {
+    std::size_t written = 0;
+    while (written < out->size()) {
+        ssize_t n = write(fd_, out->data() + written, out->size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ThrowErrno("Cannot write the spill file");
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    file_size_ += out->size();
+    out->clear();
+}
+
+EntrySpill::Extent EntrySpill::Merge(const Extent* extents, std::size_t count) {
+    std::size_t buffer_size = std::clamp<std::size_t>(memory_limit_ / 4 / count,
+                                                      kMinReadBufferSize, kIoBufferSize);
+    std::vector<std::unique_ptr<RunReader>> readers;
+    std::priority_queue<MergeHead, std::vector<MergeHead>, MergeHeadGreater> heap;
+    auto advance = [&](std::size_t source) {
+        MergeHead head;
+        head.source = source;
+        if (readers[source]->Next(&head)) heap.push(head);
+    };
+    for (std::size_t i = 0; i < count; ++i) {
+        readers.push_back(std::make_unique<RunReader>(fd_, extents[i], buffer_size));
+    }
+    for (std::size_t source = 0; source < count; ++source) advance(source);
+
+    // The merged extent goes after everything else in the file; the ones it
+    // replaces are left unused.
+    Extent merged = {file_size_, file_size_};
+    std::string out;
+    out.reserve(kIoBufferSize);
+    while (!heap.empty()) {
+        MergeHead head = heap.top();
+        heap.pop();
+        AppendEntry(&out, head.summary, head.oid, head.author_name);
+        // Only now may the source's buffer move.
+        advance(head.source);
+        if (out.size() >= kIoBufferSize) Write(&out);
+    }
+    Write(&out);
+    merged.end = file_size_;
+    return merged;
+}
+
+void EntrySpill::ForEach(std::size_t section, CommitType type,
+                         const std::function<void(const CommitEntry&)>& fn) const {
+    if (!finished_) {
+        throw std::logic_error("EntrySpill::ForEach() called before Finish()");
+    }
+    std::size_t key = section * kCommitTypeCount + CommitTypeIndex(type);
+
+    if (runs_ == 0) {
+        auto by_key = [](const Record& r) {
+            return std::size_t{r.section} * kCommitTypeCount + r.type;
+        };
+        auto first = std::lower_bound(
+            records_.begin(), records_.end(), key,
+            [&](const Record& r, std::size_t k) { return by_key(r) < k; });
+        for (; first != records_.end() && by_key(*first) == key; ++first) {
+            const char* text = text_.data() + first->text;
+            fn(CommitEntry{{text, first->summary_size},
+                           first->oid,
+                           {text + first->summary_size, first->author_size}});
+        }
+        return;
+    }
+
+    // Finish() left at most one extent per section's type.
+    if (key >= extents_.size() || extents_[key].empty()) return;
+    RunReader reader(fd_, extents_[key].front(),
+                     std::clamp<std::size_t>(memory_limit_ / 4, kMinReadBufferSize,
+                                             kIoBufferSize));
+    MergeHead head;
+    while (reader.Next(&head)) {
+        fn(CommitEntry{head.summary, head.oid, head.author_name});
+    }
+}
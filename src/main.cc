@@ -1,7 +1,22 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+
 #include <argparse/argparse.hpp>
 #include <spdlog/spdlog.h>
 
 #include "changelog.h"
+#include "utils.h"
+
+namespace {
+
+volatile std::sig_atomic_t g_stop_requested = 0;
+
+void RequestStop(int) { g_stop_requested = 1; }
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
     argparse::ArgumentParser program("changelog", CHANGELOG_VERSION);
@@ -10,10 +25,21 @@ int main(int argc, char* argv[]) {
         .default_value(std::string{"."})
         .help("Path to git repository");
 
+    program.add_argument("--bare")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Open the repository as a git directory, e.g. a bare mirror");
+
     program.add_argument("-o", "--output")
         .default_value(std::string{"CHANGELOG.md"})
         .help("Output changelog file path");
 
+    program.add_argument("--format")
+        .default_value(std::string{"md"})
+        .help(
+            "Comma-separated output formats: md, plus jsonl and bin written next to "
+            "the changelog");
+
     program.add_argument("-u", "--url")
         .default_value(std::string())
         .help(
@@ -25,6 +51,95 @@ int main(int argc, char* argv[]) {
         .default_value(std::vector<std::string>{})
         .help("Paths to filter commits by");
 
+    program.add_argument("--manifest")
+        .default_value(std::string())
+        .help(
+            "Generate every changelog listed in this file, one \"<output> "
+            "[<follow>...]\" per line, from a single walk");
+
+    program.add_argument("--incremental")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Only walk commits newer than those already in the changelog");
+
+    program.add_argument("--cache")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Cache commit classification in .changelog-cache next to the output");
+
+    program.add_argument("--since")
+        .default_value(std::string())
+        .help("Leave out the history of this revision or tag, e.g. v3.2.0");
+
+    program.add_argument("--range")
+        .default_value(std::string())
+        .help("Walk the commits in A..B instead of everything reachable from HEAD");
+
+    program.add_argument("--max-count")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Walk at most this many commits, newest first (0 for no limit)");
+
+    program.add_argument("-j", "--jobs")
+        .default_value(1)
+        .scan<'i', int>()
+        .help("Number of threads used to classify commits");
+
+    program.add_argument("--pipeline-depth")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Walk, load and classify commits as a pipeline whose stages queue "
+              "up to this many batches (0 to disable)");
+
+    program.add_argument("--pipeline-batch")
+        .default_value(256)
+        .scan<'i', int>()
+        .help("Commits passed between pipeline stages at a time");
+
+    program.add_argument("--no-index")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Don't keep a sidecar index next to the changelog; parse it every run");
+
+    program.add_argument("--by-tag")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Rebuild the changelog with one section per release tag");
+
+    program.add_argument("--pack-order")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Load commits in packfile order, for cold caches and slow disks");
+
+    program.add_argument("--memory-limit")
+        .default_value(0)
+        .scan<'i', int>()
+        .help("Keep at most this many MiB of collected entries in memory, spilling "
+              "sorted runs to TMPDIR beyond that (0 for no limit). Only the "
+              "entries are bounded, not the walk's per-commit state");
+
+    program.add_argument("--watch")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Keep running and update the changelog whenever HEAD moves. Not "
+              "with --range or --max-count");
+
+    program.add_argument("--watch-interval")
+        .default_value(2000)
+        .scan<'i', int>()
+        .help("Milliseconds between HEAD checks when no ref change is seen");
+
+    program.add_argument("--stats")
+        .default_value(false)
+        .implicit_value(true)
+        .help("Print per-phase timings and counters when done; with --watch, "
+              "those of the last update");
+
+    program.add_argument("--trace-json")
+        .default_value(std::string())
+        .help("Write Chrome trace-event JSON of the run to this file; with "
+              "--watch, of the last update");
+
     program.add_argument("-v", "--verbose")
         .default_value(false)
         .implicit_value(true)
@@ -44,17 +159,113 @@ int main(int argc, char* argv[]) {
 
     Changelog::Config config;
     config.repo = program.get<std::string>("--repo");
+    config.bare = program.get<bool>("--bare");
     config.output = program.get<std::string>("--output");
     config.url = program.get<std::string>("--url");
     config.follow = program.get<std::vector<std::string>>("--follow");
+    config.incremental = program.get<bool>("--incremental");
+    config.jobs = std::max(1, program.get<int>("--jobs"));
+    config.pipeline_depth =
+        static_cast<std::size_t>(std::max(0, program.get<int>("--pipeline-depth")));
+    config.pipeline_batch =
+        static_cast<std::size_t>(std::max(1, program.get<int>("--pipeline-batch")));
+    config.pack_order = program.get<bool>("--pack-order");
+    config.by_tag = program.get<bool>("--by-tag");
+    config.index = !program.get<bool>("--no-index");
+    config.memory_limit =
+        static_cast<std::size_t>(std::max(0, program.get<int>("--memory-limit")))
+        << 20;
+    {
+        bool markdown = false;
+        std::string formats = program.get<std::string>("--format");
+        std::size_t start = 0;
+        while (start <= formats.size()) {
+            std::size_t comma = std::min(formats.find(',', start), formats.size());
+            std::string format = formats.substr(start, comma - start);
+            if (format == "md") {
+                markdown = true;
+            } else if (format == "jsonl") {
+                config.jsonl = true;
+            } else if (format == "bin") {
+                config.binary = true;
+            } else {
+                spdlog::error("Unknown output format \"{}\"", format);
+                return EXIT_FAILURE;
+            }
+            start = comma + 1;
+        }
+        // The markdown is what records which commits earlier runs covered.
+        if (!markdown) {
+            spdlog::error("--format must include md");
+            return EXIT_FAILURE;
+        }
+    }
+    config.trace = !program.get<std::string>("--trace-json").empty();
+    config.since = program.get<std::string>("--since");
+    config.range = program.get<std::string>("--range");
+    config.max_count =
+        static_cast<std::size_t>(std::max(0, program.get<int>("--max-count")));
+    std::string manifest = program.get<std::string>("--manifest");
+    if (program.get<bool>("--cache")) {
+        // A batch shares one cache, kept next to its manifest.
+        const std::string& anchor = manifest.empty() ? config.output : manifest;
+        config.cache =
+            (std::filesystem::path(anchor).parent_path() / ".changelog-cache").string();
+    }
+
+    std::vector<Changelog::Target> targets;
+    if (!manifest.empty()) {
+        if (!std::filesystem::exists(manifest)) {
+            spdlog::error("Manifest {} not found", manifest);
+            return EXIT_FAILURE;
+        }
+        MappedFile manifest_file(manifest);
+        targets = Changelog::ParseManifest(manifest_file.data());
+        if (targets.empty()) {
+            spdlog::error("No changelogs listed in manifest {}", manifest);
+            return EXIT_FAILURE;
+        }
+    }
 
     if (!config.url.empty() && config.url.back() == '/') {
         config.url.pop_back();
     }
 
+    bool watch = program.get<bool>("--watch");
+    // A fixed set of commits never gains new entries, so watching it would
+    // only repeat the same walk on every ref change.
+    if (watch && (!config.range.empty() || config.max_count > 0)) {
+        spdlog::error("--watch cannot be combined with --range or --max-count");
+        return EXIT_FAILURE;
+    }
+    if (watch && config.memory_limit > 0) {
+        spdlog::warn("--memory-limit has no effect with --watch, which keeps the "
+                     "changelogs in memory");
+    }
+    auto watch_interval =
+        std::chrono::milliseconds(std::max(1, program.get<int>("--watch-interval")));
+    bool print_stats = program.get<bool>("--stats");
+    std::string trace_json = program.get<std::string>("--trace-json");
+
     try {
+        if (targets.empty()) {
+            targets.push_back({config.output, config.follow});
+        }
         Changelog changelog(std::move(config));
-        changelog.Generate();
+        if (watch) {
+            std::signal(SIGINT, RequestStop);
+            std::signal(SIGTERM, RequestStop);
+            changelog.Watch(targets, watch_interval,
+                            [] { return g_stop_requested != 0; });
+        } else {
+            changelog.GenerateBatch(targets);
+        }
+        if (print_stats) {
+            std::cout << changelog.stats().Summary();
+        }
+        if (!trace_json.empty()) {
+            changelog.stats().WriteTraceJson(trace_json);
+        }
     } catch (const std::exception& err) {
         spdlog::error("Failed to generate changelog: {}", err.what());
         return EXIT_FAILURE;
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+#include <spdlog/spdlog.h>
+
+#include "pack_index.h"
+#include "utils.h"
+
+namespace {
+
+constexpr unsigned char kIndexMagic[4] = {0xff, 't', 'O', 'c'};
+constexpr std::size_t kHeaderSize = 8;
+constexpr std::size_t kFanoutSize = 256 * 4;
+// Offsets with this bit set index the table of 64-bit offsets instead.
+constexpr std::uint32_t kLargeOffsetFlag = 0x80000000u;
+
+}  // namespace
+
+PackIndex::PackIndex(const std::string& pack_dir) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(pack_dir, ec)) {
+        if (entry.path().extension() == ".idx") paths.push_back(entry.path().string());
+    }
+    // Pack numbers only order reads, but keep them stable across runs.
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths) {
+        if (!Add(path)) spdlog::debug("Ignoring unsupported pack index {}", path);
+    }
+}
+
+bool PackIndex::Add(const std::string& path) {
+    MappedFile file(path);
+    std::string_view data = file.data();
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+
+    // Header, fanout, then per object its OID, CRC and 32-bit offset, then
+    // the 64-bit offsets and two checksums.
+    if (data.size() < kHeaderSize + kFanoutSize + 2 * GIT_OID_SHA1_SIZE ||
+        std::memcmp(bytes, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+        ReadBigEndian32(bytes + 4) != 2) {
+        return false;
+    }
+    const unsigned char* fanout = bytes + kHeaderSize;
+    std::uint32_t count = ReadBigEndian32(fanout + kFanoutSize - 4);
+
+    std::size_t oids = kHeaderSize + kFanoutSize;
+    std::size_t offsets = oids + std::size_t{count} * (GIT_OID_SHA1_SIZE + 4);
+    std::size_t large_offsets = offsets + std::size_t{count} * 4;
+    std::size_t trailer = data.size() - 2 * GIT_OID_SHA1_SIZE;
+    if (large_offsets > trailer || (trailer - large_offsets) % 8 != 0) return false;
+
+    Index index;
+    index.fanout = fanout;
+    index.oids = bytes + oids;
+    index.offsets = bytes + offsets;
+    index.large_offsets = bytes + large_offsets;
+    index.count = count;
+    index.large_count = static_cast<std::uint32_t>((trailer - large_offsets) / 8);
+    index.file = std::move(file);
+    indexes_.push_back(std::move(index));
+    return true;
+}
+
+std::optional<PackIndex::Location> PackIndex::Find(const git_oid& oid) const {
+    unsigned char first = oid.id[0];
+    for (std::size_t pack = 0; pack < indexes_.size(); ++pack) {
+        const Index& index = indexes_[pack];
+        std::uint32_t lo =
+            first == 0 ? 0 : ReadBigEndian32(index.fanout + 4 * (first - 1));
+        std::uint32_t hi = ReadBigEndian32(index.fanout + 4 * first);
+        if (hi > index.count) continue;
+        while (lo < hi) {
+            std::uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(index.oids + std::size_t{mid} * GIT_OID_SHA1_SIZE,
+                                  oid.id, GIT_OID_SHA1_SIZE);
+            if (cmp < 0) {
+                lo = mid + 1;
+            } else if (cmp > 0) {
+                hi = mid;
+            } else {
+                std::uint64_t offset =
+                    ReadBigEndian32(index.offsets + 4 * std::size_t{mid});
+                if (offset & kLargeOffsetFlag) {
+                    std::uint32_t large = offset & ~kLargeOffsetFlag;
+                    if (large >= index.large_count) break;
+                    offset =
+                        ReadBigEndian64(index.large_offsets + 8 * std::size_t{large});
+                }
+                return Location{static_cast<std::uint32_t>(pack), offset};
+            }
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "path_trie.h"
+
+namespace {
+
+struct GitTreeDeleter {
+    void operator()(git_tree* t) const { git_tree_free(t); }
+};
+
+using UniqueTree = std::unique_ptr<git_tree, GitTreeDeleter>;
+
+// The tree `entry` names; null when there is no entry or it is not a tree.
+UniqueTree LoadSubtree(git_repository* repo, const git_tree_entry* entry) {
+    if (!entry || git_tree_entry_type(entry) != GIT_OBJECT_TREE) return nullptr;
+    git_tree* tree_raw = nullptr;
+    if (git_tree_lookup(&tree_raw, repo, git_tree_entry_id(entry)) < 0) {
+        const git_error* e = git_error_last();
+        throw std::runtime_error(std::string("Failed to get tree: ") +
+                                 (e ? e->message : "unknown error"));
+    }
+    return UniqueTree(tree_raw);
+}
+
+bool SameEntry(const git_tree_entry* a, const git_tree_entry* b) {
+    if (!a || !b) return a == b;
+    return git_oid_equal(git_tree_entry_id(a), git_tree_entry_id(b)) &&
+           git_tree_entry_filemode(a) == git_tree_entry_filemode(b);
+}
+
+}  // namespace
+
+PathTrie::PathTrie(const std::vector<std::string>& paths) : covered_(paths.size()) {
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        if (!IsLiteral(paths[i])) continue;
+        covered_[i] = true;
+
+        std::string_view rest = paths[i];
+        while (rest.back() == '/') rest.remove_suffix(1);
+        std::size_t node = 0;
+        while (true) {
+            std::size_t slash = rest.find('/');
+            std::string_view component = rest.substr(0, slash);
+            auto& children = nodes_[node].children;
+            auto it = std::find_if(children.begin(), children.end(),
+                                   [&](const auto& c) { return c.first == component; });
+            if (it != children.end()) {
+                node = it->second;
+            } else {
+                children.emplace_back(std::string(component), nodes_.size());
+                node = nodes_.size();
+                nodes_.emplace_back();
+            }
+            if (slash == std::string_view::npos) break;
+            rest.remove_prefix(slash + 1);
+        }
+        nodes_[node].paths.push_back(i);
+    }
+}
+
+bool PathTrie::IsLiteral(const std::string& path) {
+    if (path.empty() || path == "." || path.front() == '/' || path.front() == '!') {
+        return false;
+    }
+    return path.find_first_of("*?[\\") == std::string::npos &&
+           path.find("//") == std::string::npos;
+}
+
+void PathTrie::Match(git_repository* repo, git_tree* parent_tree, git_tree* commit_tree,
+                     std::vector<bool>* touches) const {
+    MatchNode(repo, nodes_[0], parent_tree, commit_tree, touches);
+}
+
+void PathTrie::MatchNode(git_repository* repo, const Node& node,
+                         const git_tree* parent_tree, const git_tree* commit_tree,
+                         std::vector<bool>* touches) const {
+    for (const auto& [name, index] : node.children) {
+        const git_tree_entry* old_entry =
+            parent_tree ? git_tree_entry_byname(parent_tree, name.c_str()) : nullptr;
+        const git_tree_entry* new_entry =
+            commit_tree ? git_tree_entry_byname(commit_tree, name.c_str()) : nullptr;
+        if (SameEntry(old_entry, new_entry)) continue;
+
+        // The entry changed, and so did every path ending at it. Paths below
+        // it may still be unchanged, so the subtrees are compared in turn; a
+        // side that is not a tree has none of them.
+        const Node& child = nodes_[index];
+        for (std::size_t path : child.paths) (*touches)[path] = true;
+        if (child.children.empty()) continue;
+        UniqueTree old_subtree = LoadSubtree(repo, old_entry);
+        UniqueTree new_subtree = LoadSubtree(repo, new_entry);
+        MatchNode(repo, child, old_subtree.get(), new_subtree.get(), touches);
+    }
+}
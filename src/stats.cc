@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "stats.h"
+#include "utils.h"
+
+namespace {
+
+// Small per-thread ids for the trace, numbered in the order threads first
+// create stats or close a timer.
+int ThreadIndex() {
+    static std::atomic<int> next{0};
+    thread_local int index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// Number and innermost of the timers currently open on this thread.
+thread_local int g_timer_depth = 0;
+thread_local const char* g_open_timer = nullptr;
+
+// One line of the summary table: `label` padded to a fixed column, then the
+// already formatted `columns`.
+void AppendRow(std::string* out, std::string_view label, const char* columns) {
+    constexpr std::size_t kLabelWidth = 32;
+    out->append(label);
+    out->append(label.size() < kLabelWidth ? kLabelWidth - label.size() : 1, ' ');
+    out->append(columns).push_back('\n');
+}
+
+}  // namespace
+
+Stats::Stats()
+    : start_(std::chrono::steady_clock::now()), owner_thread_(ThreadIndex()) {}
+
+void Stats::Max(Counter counter, std::uint64_t value) {
+    auto& slot = counters_[static_cast<std::size_t>(counter)];
+    std::uint64_t cur = slot.load(std::memory_order_relaxed);
+    while (cur < value &&
+           !slot.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+}
+
+void Stats::KeepSpans(std::size_t max_spans) {
+    std::lock_guard<std::mutex> lock(mu_);
+    max_spans_ = max_spans;
+    spans_.clear();
+    next_span_ = 0;
+}
+
+void Stats::Reset() {
+    for (auto& counter : counters_) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(mu_);
+    start_ = std::chrono::steady_clock::now();
+    phases_.clear();
+    spans_.clear();
+    next_span_ = 0;
+}
+
+std::int64_t Stats::Micros(std::chrono::steady_clock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - start_).count();
+}
+
+void Stats::Record(const Span& span) {
+    bool worker = span.thread != owner_thread_;
+    std::string_view parent = span.parent ? span.parent : "";
+    std::lock_guard<std::mutex> lock(mu_);
+    // There are only a few dozen distinct phases.
+    auto it = std::find_if(phases_.begin(), phases_.end(), [&](const Phase& p) {
+        return p.name == span.name && p.parent == parent && p.worker == worker &&
+               p.depth == span.depth;
+    });
+    if (it == phases_.end()) {
+        Phase phase = {span.name, parent, worker, span.depth, span.start_us};
+        it = phases_.insert(phases_.end(), phase);
+    }
+    it->first_start_us = std::min(it->first_start_us, span.start_us);
+    ++it->calls;
+    it->total_us += span.duration_us;
+
+    if (max_spans_ == 0) return;
+    if (spans_.size() < max_spans_) {
+        spans_.push_back(span);
+    } else {
+        spans_[next_span_] = span;
+        next_span_ = (next_span_ + 1) % max_spans_;
+    }
+}
+
+Stats::Timer::Timer(Stats* stats, const char* name)
+    : stats_(stats),
+      name_(name),
+      parent_(g_open_timer),
+      start_(std::chrono::steady_clock::now()) {
+    ++g_timer_depth;
+    g_open_timer = name_;
+}
+
+Stats::Timer::~Timer() {
+    auto end = std::chrono::steady_clock::now();
+    --g_timer_depth;
+    g_open_timer = parent_;
+    stats_->Record({
+        name_,
+        parent_,
+        stats_->Micros(start_),
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start_).count(),
+        ThreadIndex(),
+        g_timer_depth,
+    });
+}
+
+std::string Stats::Summary() const {
+    std::vector<Phase> phases;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        phases = phases_;
+    }
+    // Spans are recorded as they close, so outer phases come last; list
+    // them in the order they started instead, outer phases first. Worker
+    // phases overlap the main thread's and are summed over all workers, so
+    // they go after it.
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase& a, const Phase& b) {
+        if (a.worker != b.worker) return b.worker;
+        if (a.first_start_us != b.first_start_us) {
+            return a.first_start_us < b.first_start_us;
+        }
+        return a.depth < b.depth;
+    });
+
+    std::string out;
+    AppendRow(&out, "Phase", "Calls      Total ms");
+    for (const Phase& phase : phases) {
+        std::string label(2 * phase.depth, ' ');
+        label.append(phase.name);
+        if (phase.worker) label.append(" (workers)");
+        char columns[64];
+        std::snprintf(columns, sizeof(columns), "%5zu %13.3f", phase.calls,
+                      phase.total_us / 1000.0);
+        AppendRow(&out, label, columns);
+    }
+    out.push_back('\n');
+    AppendRow(&out, "Counter", "              Value");
+    for (std::size_t i = 0; i < kCounterCount; ++i) {
+        char columns[32];
+        std::snprintf(columns, sizeof(columns), "%19llu",
+                      static_cast<unsigned long long>(
+                          counters_[i].load(std::memory_order_relaxed)));
+        AppendRow(&out, kCounterNames[i], columns);
+    }
+    return out;
+}
+
+void Stats::WriteTraceJson(const std::string& path) const {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    auto event = [&](std::string_view name, const char* phase, std::int64_t ts,
+                     int thread) {
+        json.append("{\"name\":\"").append(name).append("\",\"cat\":\"changelog\"");
+        json.append(",\"ph\":\"").append(phase).append("\"");
+        json.append(",\"ts\":").append(std::to_string(ts));
+        json.append(",\"pid\":1,\"tid\":").append(std::to_string(thread));
+    };
+
+    int threads = owner_thread_ + 1;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        // Oldest first; once the ring is full that is the slot written next.
+        for (std::size_t i = 0; i < spans_.size(); ++i) {
+            const Span& span = spans_[(next_span_ + i) % spans_.size()];
+            event(span.name, "X", span.start_us, span.thread);
+            json.append(",\"dur\":").append(std::to_string(span.duration_us));
+            json.append("},\n");
+            threads = std::max(threads, span.thread + 1);
+        }
+    }
+    for (int t = owner_thread_; t < threads; ++t) {
+        event("thread_name", "M", 0, t);
+        json.append(",\"args\":{\"name\":\"")
+            .append(t == owner_thread_ ? "main" : "worker " + std::to_string(t))
+            .append("\"}},\n");
+    }
+
+    // Counters are reported once, as their final values.
+    event("counters", "C", Micros(std::chrono::steady_clock::now()), owner_thread_);
+    json.append(",\"args\":{");
+    for (std::size_t i = 0; i < kCounterCount; ++i) {
+        if (i > 0) json.push_back(',');
+        json.append("\"").append(kCounterNames[i]).append("\":");
+        json.append(std::to_string(counters_[i].load(std::memory_order_relaxed)));
+    }
+    json.append("}}\n]}\n");
+
+    WriteFileAtomic(path, {json});
+}
@@ -1,4 +1,23 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
 #include <string>
+#include <system_error>
 #include <vector>
 
 #include "utils.h"
@@ -21,3 +40,282 @@ std::vector<std::string> split(const std::string& str, const std::string& sep) {
 
     return result;
 }
+
+void Checksum::Add(std::string_view data) {
+    size_ += data.size();
+    while (!data.empty()) {
+        if (pending_size_ == 0 && data.size() >= sizeof(std::uint64_t)) {
+            std::uint64_t word;
+            std::memcpy(&word, data.data(), sizeof(word));
+            Mix(word);
+            data.remove_prefix(sizeof(word));
+            continue;
+        }
+        pending_[pending_size_++] = data.front();
+        data.remove_prefix(1);
+        if (pending_size_ == sizeof(pending_)) Flush();
+    }
+}
+
+std::uint64_t Checksum::Finish() {
+    if (pending_size_ > 0) {
+        std::memset(pending_ + pending_size_, 0, sizeof(pending_) - pending_size_);
+        Flush();
+    }
+    Mix(size_);
+    return hash_ ^ (hash_ >> 29);
+}
+
+void Checksum::Mix(std::uint64_t word) {
+    hash_ ^= word * 0x9e3779b97f4a7c15ull;
+    hash_ = (hash_ << 27 | hash_ >> 37) * 0xff51afd7ed558ccdull;
+}
+
+void Checksum::Flush() {
+    std::uint64_t word;
+    std::memcpy(&word, pending_, sizeof(word));
+    Mix(word);
+    pending_size_ = 0;
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st = {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                          MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            addr_ = addr;
+            size_ = static_cast<std::size_t>(st.st_size);
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (addr_) {
+        munmap(addr_, size_);
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& o) noexcept : addr_(o.addr_), size_(o.size_) {
+    o.addr_ = nullptr;
+    o.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& o) noexcept {
+    if (this != &o) {
+        if (addr_) {
+            munmap(addr_, size_);
+        }
+        addr_ = o.addr_;
+        size_ = o.size_;
+        o.addr_ = nullptr;
+        o.size_ = 0;
+    }
+    return *this;
+}
+
+std::string_view StringArena::Store(std::string_view str) {
+    if (str.empty()) return {};
+    if (str.size() > left_) {
+        // Oversized strings get a block of their own so the current block's
+        // tail is not wasted.
+        if (str.size() > kBlockSize / 4) {
+            blocks_.push_back(std::make_unique<char[]>(str.size()));
+            std::memcpy(blocks_.back().get(), str.data(), str.size());
+            return {blocks_.back().get(), str.size()};
+        }
+        blocks_.push_back(std::make_unique<char[]>(kBlockSize));
+        cur_ = blocks_.back().get();
+        left_ = kBlockSize;
+    }
+    std::memcpy(cur_, str.data(), str.size());
+    std::string_view stored(cur_, str.size());
+    cur_ += str.size();
+    left_ -= str.size();
+    return stored;
+}
+
+std::string_view StringArena::Intern(std::string_view str) {
+    auto it = interned_.find(str);
+    if (it != interned_.end()) return *it;
+    std::string_view stored = Store(str);
+    interned_.insert(stored);
+    return stored;
+}
+
+namespace {
+
+[[noreturn]] void ThrowErrno(const std::string& msg) {
+    throw std::runtime_error(msg + ": " + std::strerror(errno));
+}
+
+mode_t DefaultFileMode() {
+    mode_t mask = umask(0);
+    umask(mask);
+    return 0666 & ~mask;
+}
+
+// The rename itself is only durable once the directory holding it is synced.
+void SyncParentDirectory(const std::string& path) {
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "."
+                      : slash == 0             ? "/"
+                                               : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        ThrowErrno("Cannot open directory " + dir);
+    }
+    int rc = fsync(fd);
+    int err = errno;
+    close(fd);
+    // Some file systems cannot sync directories at all; the rename is as
+    // durable there as it gets.
+    if (rc != 0 && err != EINVAL && err != ENOTSUP) {
+        errno = err;
+        ThrowErrno("Cannot sync directory " + dir);
+    }
+}
+
+// The file a write to `path` should replace: `path` itself, or the final
+// target when it is a symlink, which may not exist yet. Renaming over the
+// target keeps the link in place, as writing through it would.
+std::string ResolveSymlinks(const std::string& path) {
+    namespace fs = std::filesystem;
+    fs::path resolved = path;
+    std::error_code ec;
+    // Linux gives up after as many links.
+    for (int links = 0; links < 40 && fs::is_symlink(resolved, ec); ++links) {
+        fs::path target = fs::read_symlink(resolved, ec);
+        if (ec) break;
+        resolved = target.is_absolute() ? target : resolved.parent_path() / target;
+    }
+    return resolved.string();
+}
+
+}  // namespace
+
+AtomicFileWriter::AtomicFileWriter(const std::string& path)
+    : path_(ResolveSymlinks(path)), tmp_path_(path_ + ".XXXXXX") {
+    fd_ = mkstemp(tmp_path_.data());
+    if (fd_ < 0) {
+        ThrowErrno("Cannot create temporary file for " + path_);
+    }
+
+    struct stat st = {};
+    mode_t mode = stat(path_.c_str(), &st) == 0 ? st.st_mode & 07777 : DefaultFileMode();
+    if (fchmod(fd_, mode) != 0) {
+        int err = errno;
+        close(fd_);
+        std::remove(tmp_path_.c_str());
+        errno = err;
+        ThrowErrno("Cannot set mode of " + tmp_path_);
+    }
+}
+
+AtomicFileWriter::~AtomicFileWriter() {
+    if (fd_ >= 0) {
+        close(fd_);
+        std::remove(tmp_path_.c_str());
+    }
+}
+
+void AtomicFileWriter::Append(const std::vector<std::string_view>& parts) {
+    std::vector<iovec> iov;
+    iov.reserve(parts.size());
+    for (std::string_view part : parts) {
+        if (part.empty()) continue;
+        iov.push_back({const_cast<char*>(part.data()), part.size()});
+    }
+
+    // writev may stop short, and takes at most IOV_MAX buffers per call.
+    std::size_t next = 0;
+    while (next < iov.size()) {
+        int count = static_cast<int>(std::min<std::size_t>(iov.size() - next, IOV_MAX));
+        ssize_t written = writev(fd_, &iov[next], count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            ThrowErrno("Cannot write " + tmp_path_);
+        }
+        auto left = static_cast<std::size_t>(written);
+        while (next < iov.size() && left >= iov[next].iov_len) {
+            left -= iov[next].iov_len;
+            ++next;
+        }
+        if (left > 0) {
+            iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + left;
+            iov[next].iov_len -= left;
+        }
+    }
+}
+
+void AtomicFileWriter::Commit() {
+    if (fsync(fd_) != 0) {
+        ThrowErrno("Cannot sync " + tmp_path_);
+    }
+    int fd = fd_;
+    fd_ = -1;
+    if (close(fd) != 0) {
+        std::remove(tmp_path_.c_str());
+        ThrowErrno("Cannot close " + tmp_path_);
+    }
+    if (std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+        std::remove(tmp_path_.c_str());
+        ThrowErrno("Cannot replace " + path_);
+    }
+    SyncParentDirectory(path_);
+}
+
+void WriteFileAtomic(const std::string& path, const std::vector<std::string_view>& parts) {
+    AtomicFileWriter file(path);
+    file.Append(parts);
+    file.Commit();
+}
+
+DirectoryWatcher::DirectoryWatcher(const std::vector<std::string>& dirs) {
+#ifdef __linux__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) return;
+    // Ref updates write a lock file and rename it into place.
+    constexpr std::uint32_t kMask =
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_DELETE_SELF;
+    bool any = false;
+    for (const auto& dir : dirs) {
+        any = inotify_add_watch(fd_, dir.c_str(), kMask) >= 0 || any;
+    }
+    if (!any) {
+        close(fd_);
+        fd_ = -1;
+    }
+#else
+    (void)dirs;
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool DirectoryWatcher::Wait(std::chrono::milliseconds timeout) {
+    int timeout_ms = static_cast<int>(
+        std::min<std::chrono::milliseconds::rep>(timeout.count(), INT_MAX));
+    if (fd_ < 0) {
+        // Sleeps like the watched case, still waking up on signals.
+        poll(nullptr, 0, timeout_ms);
+        return false;
+    }
+
+    pollfd pfd = {fd_, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0) return false;
+
+    // Only whether anything happened matters, so drain the queued events.
+    char buf[4096];
+    while (read(fd_, buf, sizeof(buf)) > 0) {
+    }
+    return true;
+}
@@ -1,7 +1,6 @@
-#include <regex>
+#include <limits>
 #include <stdexcept>
 
-#include "changelog.h"
 #include "version.h"
 
 std::string SemanticVersion::ToString() const {
@@ -9,13 +8,44 @@ std::string SemanticVersion::ToString() const {
            std::to_string(patch);
 }
 
-SemanticVersion SemanticVersion::Parse(const std::string& str) {
-    std::regex re(R"(^v?(\d+)\.(\d+)\.(\d+)$)");
-    std::smatch m;
-    if (!std::regex_match(str, m, re)) {
-        throw std::runtime_error("Invalid version string: " + str);
+std::optional<SemanticVersion> SemanticVersion::TryParse(std::string_view str) {
+    if (!str.empty() && str.front() == 'v') {
+        str.remove_prefix(1);
     }
-    return {std::stoi(m[1]), std::stoi(m[2]), std::stoi(m[3])};
+
+    // Reads one run of digits into `out` and consumes it from `str`.
+    auto number = [&str](int& out) {
+        std::size_t i = 0;
+        long long value = 0;
+        while (i < str.size() && str[i] >= '0' && str[i] <= '9') {
+            value = value * 10 + (str[i] - '0');
+            if (value > std::numeric_limits<int>::max()) return false;
+            ++i;
+        }
+        str.remove_prefix(i);
+        out = static_cast<int>(value);
+        return i > 0;
+    };
+    auto dot = [&str]() {
+        if (str.empty() || str.front() != '.') return false;
+        str.remove_prefix(1);
+        return true;
+    };
+
+    SemanticVersion v;
+    if (number(v.major) && dot() && number(v.minor) && dot() && number(v.patch) &&
+        str.empty()) {
+        return v;
+    }
+    return std::nullopt;
+}
+
+SemanticVersion SemanticVersion::Parse(std::string_view str) {
+    std::optional<SemanticVersion> v = TryParse(str);
+    if (!v) {
+        throw std::runtime_error("Invalid version string: " + std::string(str));
+    }
+    return *v;
 }
 
 bool SemanticVersion::operator==(const SemanticVersion& o) const {
@@ -29,7 +59,7 @@ bool SemanticVersion::operator<(const SemanticVersion& o) const {
 }
 
 SemanticVersion ComputeNextVersion(const SemanticVersion& base,
-                                   const std::set<CommitType>& types,
+                                   const CommitTypeSet& types,
                                    bool has_breaking_change) {
     SemanticVersion v = base;
 
@@ -40,13 +70,10 @@ SemanticVersion ComputeNextVersion(const SemanticVersion& base,
         return v;
     }
 
-    bool has_minor = false, has_patch = false;
-    for (auto t : types) {
-        if (t == CommitType::kFeat || t == CommitType::kAdd) has_minor = true;
-        if (t == CommitType::kFix || t == CommitType::kPerf ||
-            t == CommitType::kRefactor)
-            has_patch = true;
-    }
+    auto has = [&types](CommitType t) { return types[CommitTypeIndex(t)]; };
+    bool has_minor = has(CommitType::kFeat) || has(CommitType::kAdd);
+    bool has_patch =
+        has(CommitType::kFix) || has(CommitType::kPerf) || has(CommitType::kRefactor);
 
     if (has_minor) {
         v.minor++;
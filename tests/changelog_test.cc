@@ -0,0 +1,312 @@
+#include <fstream>
+#include <optional>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <git2.h>
+#include <gtest/gtest.h>
+
+#include "changelog.h"
+
+// Reaches the private parsing stages of Changelog.
+struct ChangelogTestAccess {
+    static std::string_view ChangelogBody(std::string_view content) {
+        return Changelog::ChangelogBody(content);
+    }
+    static std::vector<ParsedSection> ParseChangelog(std::string_view content) {
+        return Changelog::ParseChangelogStructured(Changelog::ChangelogBody(content));
+    }
+    static SummaryClass ClassifySummary(std::string_view summary) {
+        return Changelog::ClassifySummary(summary);
+    }
+    static std::optional<CommitType> CategorizeCommit(std::string_view summary) {
+        return Changelog::CategorizeCommit(summary);
+    }
+    static bool IsBreakingChange(std::string_view summary) {
+        return Changelog::IsBreakingChange(summary);
+    }
+};
+
+namespace {
+
+using Access = ChangelogTestAccess;
+
+std::string ReadFixture(const char* name) {
+    std::ifstream in(std::string(CHANGELOG_TEST_DATA_DIR) + "/" + name,
+                     std::ios::binary);
+    EXPECT_TRUE(in) << "missing fixture " << name;
+    std::ostringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+std::string HashOf(const git_oid& oid) {
+    char hex[GIT_OID_SHA1_HEXSIZE + 1];
+    git_oid_tostr(hex, sizeof(hex), &oid);
+    return hex;
+}
+
+// One line per section and per entry, so a mismatch shows the first place
+// the parsers disagree.
+std::vector<std::string> Describe(const std::vector<ParsedSection>& sections) {
+    std::vector<std::string> lines;
+    for (const ParsedSection& section : sections) {
+        std::string version = section.version ? section.version->ToString() : "";
+        lines.push_back("## " + section.name + "|" + version + "|" + section.date +
+                        (section.has_breaking_change ? "|breaking" : ""));
+        for (const CommitTypeSpec& spec : kCommitTypeSpecs) {
+            for (const CommitEntry& entry : section.entries[spec.type]) {
+                lines.push_back(std::string(spec.name) + "|" +
+                                std::string(entry.summary) + "|" +
+                                std::string(entry.author_name) + "|" +
+                                HashOf(entry.oid));
+            }
+        }
+    }
+    return lines;
+}
+
+// The regular expressions ParseChangelogStructured() replaced, kept as the
+// reference its output is checked against.
+std::vector<std::string> DescribeWithRegexParser(std::string_view content) {
+    const std::regex section_re(
+        R"(^## (.+?)(?:@(v\d+\.\d+\.\d+))?\s+(?:--|—)\s+(\d{4}-\d{2}-\d{2})$)");
+    const std::regex type_re(R"(^### (\w+)$)");
+    const std::regex entry_re(
+        R"(^- (.+) by \*\*(.+)\*\* in \[#([a-f0-9]+)\]\((.+)/commit/([a-f0-9]+)\)$)");
+    const std::regex old_entry_re(
+        R"(^- (.+) \(\[#([a-f0-9]+)\]\((.+)/commit/([a-f0-9]+)\)\)$)");
+
+    struct Section {
+        std::string header;
+        bool breaking = false;
+        // (summary, hash, author), which sorts like CommitEntry.
+        std::set<std::tuple<std::string, std::string, std::string>>
+            entries[kCommitTypeCount];
+    };
+    std::vector<Section> sections;
+    const CommitTypeSpec* cur_type = nullptr;
+
+    std::istringstream stream{std::string(Access::ChangelogBody(content))};
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::smatch match;
+        if (std::regex_match(line, match, section_re)) {
+            std::string version;
+            if (match[2].matched) {
+                version = SemanticVersion::Parse(match[2].str()).ToString();
+            }
+            sections.emplace_back().header =
+                "## " + match[1].str() + "|" + version + "|" + match[3].str();
+            cur_type = nullptr;
+        } else if (std::regex_match(line, match, type_re)) {
+            std::string type = match[1].str();
+            for (char& c : type) c = static_cast<char>(std::tolower(c));
+            cur_type = nullptr;
+            for (const CommitTypeSpec& spec : kCommitTypeSpecs) {
+                if (spec.prefix == type) cur_type = &spec;
+            }
+        } else if (cur_type && !sections.empty()) {
+            std::string summary, author, hash;
+            if (std::regex_match(line, match, entry_re)) {
+                summary = match[1].str();
+                author = match[2].str();
+                hash = match[5].str();
+            } else if (std::regex_match(line, match, old_entry_re)) {
+                summary = match[1].str();
+                hash = match[4].str();
+            } else {
+                continue;
+            }
+            Section& section = sections.back();
+            section.entries[CommitTypeIndex(cur_type->type)].emplace(summary, hash,
+                                                                     author);
+            if (summary.find("!:") != std::string::npos) section.breaking = true;
+        }
+    }
+
+    std::vector<std::string> lines;
+    for (const Section& section : sections) {
+        lines.push_back(section.header + (section.breaking ? "|breaking" : ""));
+        for (const CommitTypeSpec& spec : kCommitTypeSpecs) {
+            for (const auto& [summary, hash, author] :
+                 section.entries[CommitTypeIndex(spec.type)]) {
+                lines.push_back(std::string(spec.name) + "|" + summary + "|" + author +
+                                "|" + hash);
+            }
+        }
+    }
+    return lines;
+}
+
+TEST(ParseChangelogTest, ReadsFixture) {
+    std::string content = ReadFixture("CHANGELOG.md");
+    std::vector<std::string> expected = {
+        "## changelog|v1.2.0|2026-03-01|breaking",
+        "Feat|feat(parser)!: drop the old format|Ayush Joshi|"
+        "1a2b3c4d5e6f708192a3b4c5d6e7f8091a2b3c4d",
+        "Feat|feat: add a flag|Jane Q. Public|0000001000000000000000000000000000000000",
+        "Fix|fix(core): keep \" by **x** in [#1](y)\" text in summaries|Ayush Joshi|"
+        "abcdef0123456789abcdef0123456789abcdef01",
+        // "--" separator, lowercase type heading, inner whitespace kept, a
+        // line with trailing whitespace skipped, and a malformed type heading
+        // leaving the previous type in effect.
+        "## changelog|v1.1.0|2026-02-28",
+        "Refactor| refactor:  keep  inner  spaces|B  C|"
+        "3333333333333333333333333333333333333333",
+        "Refactor|refactor: split the loader|A|"
+        "2222222222222222222222222222222222222222",
+        "Refactor|refactor: stays under the last type heading|A|"
+        "5555555555555555555555555555555555555555",
+        // Not a full version, so it stays part of the name. A "## " line
+        // without a date does not start a section.
+        "## changelog@v1.0||2026-02-27|breaking",
+        "Perf|perf!: avoid a copy|A|6666666666666666666666666666666666666666",
+        "Perf|perf: belongs to the section above|A|"
+        "7777777777777777777777777777777777777777",
+        "##   spaced   name||2026-02-25",
+        "Docs|docs: describe the cache|A|8888888888888888888888888888888888888888",
+        // Written by changelog@v0.1.0.
+        "## changelog||2026-02-24|breaking",
+        "Feat|feat!: old entries can be breaking too||"
+        "9999999999999999999999999999999999999999",
+        "Feat|feat: add changelog generator using libgit2||"
+        "88598b67792ed6694958b9a615fa77511455a6c7",
+    };
+    EXPECT_EQ(Describe(Access::ParseChangelog(content)), expected);
+}
+
+TEST(ParseChangelogTest, MatchesRegexParserOnFixture) {
+    std::string content = ReadFixture("CHANGELOG.md");
+    EXPECT_EQ(Describe(Access::ParseChangelog(content)),
+              DescribeWithRegexParser(content));
+}
+
+TEST(ParseChangelogTest, MatchesRegexParserOnOddLines) {
+    const std::string hash = "0123456789abcdef0123456789abcdef01234567";
+    const std::string link = "[#0123456](https://x/commit/" + hash + ")";
+    const std::vector<std::string> cases = {
+        "## name — 2026-01-01\n### Feat\n- feat: a by **b** in " + link + "\n",
+        // Header whitespace and separators.
+        "##  name  --  2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## name—2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## name --2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "##   — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "##  — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## @v1.2.3 — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x@v1.2.3 — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x@@v1.2.3 — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x@v1.2.3@v4.5.6 -- 2026-01-01\n### Fix\n- fix: a by **b** in " + link +
+            "\n",
+        "## x@1.2.3 -- 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x — 2026-1-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x — 2026-01-01 \n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\r\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x\r — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        "## x -- — 2026-01-01\n### Fix\n- fix: a by **b** in " + link + "\n",
+        // Type headings.
+        "## x — 2026-01-01\n### FEAT\n- feat: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat \n- feat: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\r\n- feat: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Features\n- feat: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n###\n- feat: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Fe-at\n- feat: a by **b** in " + link + "\n",
+        "### Feat\n- feat: before any section by **b** in " + link + "\n",
+        // Entries.
+        "## x — 2026-01-01\n### Feat\n- feat: a by **b** in " + link + "\r\n",
+        "## x — 2026-01-01\n### Feat\n-  by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\n- a by **** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\n- a by ** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in [#](https://x/commit/" + hash +
+            ")\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in [#0123456]()/commit/" + hash +
+            ")\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in [#0123456](/commit/" + hash +
+            ")\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in [#0123456](https://x/commit/)\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in [#ABCDEF0](https://x/commit/" +
+            hash + ")\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** by **c** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in " + link + " by **c** in " +
+            link + "\n",
+        "## x — 2026-01-01\n### Feat\n- feat!: a by **b** in " + link + "\n",
+        "## x — 2026-01-01\n### Feat\n- feat: a ([#0123456](https://x/commit/" + hash +
+            "))\n",
+        "## x — 2026-01-01\n### Feat\n-  ([#0123456](https://x/commit/" + hash +
+            "))\n",
+        "## x — 2026-01-01\n### Feat\n- a ([#0123456](https://x/commit/" + hash +
+            ")) \n",
+        "## x — 2026-01-01\n### Feat\n- a by **b** in ([#0123456](https://x/commit/" +
+            hash + "))\n",
+        // No trailing newline.
+        "## x — 2026-01-01\n### Feat\n- feat: a by **b** in " + link,
+    };
+    for (const std::string& content : cases) {
+        EXPECT_EQ(Describe(Access::ParseChangelog(content)),
+                  DescribeWithRegexParser(content))
+            << content;
+    }
+}
+
+struct SummaryCase {
+    const char* summary;
+    std::optional<CommitType> type;
+    bool breaking;
+};
+
+// The summaries BM_CategorizeCommit times, then edge cases of the prefix.
+const SummaryCase kSummaryCases[] = {
+    {"feat: add a flag", CommitType::kFeat, false},
+    {"feat(parser)!: drop the old format", CommitType::kFeat, true},
+    {"fix(core): handle empty input", CommitType::kFix, false},
+    {"Fix typo in README", std::nullopt, false},
+    {"refactor: split the loader", CommitType::kRefactor, false},
+    {"docs: describe the cache", CommitType::kDocs, false},
+    {"Merge branch 'topic' into main", std::nullopt, false},
+    {"chore(deps): bump spdlog", std::nullopt, false},
+    {"perf: avoid a copy", CommitType::kPerf, false},
+    {"revert: undo the last change", CommitType::kRevert, false},
+    {"deprecated: old flags", CommitType::kDeprecated, false},
+    {"test: cover edge cases", CommitType::kTest, false},
+    {"Update CHANGELOG.md", std::nullopt, false},
+    {"addition of a new parser", std::nullopt, false},
+
+    {"add: a parser", CommitType::kAdd, false},
+    {"feat!: drop the old format", CommitType::kFeat, true},
+    {"revert(feat)!: undo the flag", CommitType::kRevert, true},
+    {"docs(feat): describe the flag", CommitType::kDocs, false},
+    {"feat(scope!): the marker is outside the scope", CommitType::kFeat, false},
+    {"feat(a:b): the first colon ends the prefix", CommitType::kFeat, false},
+    {"chore(deps)!: breaking without a type", std::nullopt, true},
+    {"Merge pull request #1 from user/feat: x", std::nullopt, false},
+    {"Merge: x", std::nullopt, false},
+    {"Fix: x", CommitType::kFix, false},
+    {"FEAT!: x", CommitType::kFeat, true},
+    {"Docs(Core): x", CommitType::kDocs, false},
+    {"feature: x", std::nullopt, false},
+    {"fea: x", std::nullopt, false},
+    {"feat : x", std::nullopt, false},
+    {" feat: x", std::nullopt, false},
+    {"feat!!: x", std::nullopt, true},
+    {"!: x", std::nullopt, true},
+    {": x", std::nullopt, false},
+    {"feat", std::nullopt, false},
+    {"", std::nullopt, false},
+};
+
+TEST(ClassifySummaryTest, MatchesTable) {
+    for (const SummaryCase& c : kSummaryCases) {
+        SummaryClass result = Access::ClassifySummary(c.summary);
+        EXPECT_EQ(result.type, c.type) << c.summary;
+        EXPECT_EQ(result.breaking, c.breaking) << c.summary;
+        EXPECT_EQ(Access::CategorizeCommit(c.summary), c.type) << c.summary;
+        EXPECT_EQ(Access::IsBreakingChange(c.summary), c.breaking) << c.summary;
+    }
+}
+
+}  // namespace